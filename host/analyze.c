@@ -0,0 +1,159 @@
+// Keymap analyzer: walks every layer state reachable from the actions in the
+// keymap and reports layers and entries that can never take effect.
+// An entry on layer L is live if some reachable state resolves its position
+// to L, and the position has a key in the base layout. Anything else is
+// shadowed, on an unreachable layer, or has no key.
+// Keycodes with no layer action of their own go through the keymap's
+// process_record_user, so layers switched from user code (the board's FN key)
+// are followed too. See analyze_main.c for the command line.
+#include <stdio.h>
+#include <string.h>
+
+#include "analyze.h"
+
+static uint8_t reachable[(1 << NUM_LAYERS_MAX) / 8];
+static uint8_t live[KEYBOARD_COLS_MAX][KEYBOARD_ROWS]; // bitmask of layers
+
+static uint16_t resolve(layer_state_t layers, uint8_t row, uint8_t col, uint8_t* layer) {
+	while (layers) {
+		int i = ko_topmost_active_layer(layers);
+		uint16_t kc = keymaps[i][col][row];
+		if (kc != KC_TRANSPARENT) {
+			*layer = i;
+			return kc;
+		}
+		layers ^= 1 << i;
+	}
+	*layer = 0;
+	return KC_NO;
+}
+
+static layer_state_t user_transition(uint16_t keycode, bool pressed, layer_state_t state) {
+	keyrecord_t record = { .event = { .pressed = pressed } };
+	layer_state_t next = 0;
+
+	layer_state_set(state);
+	process_record_user(keycode, &record);
+	for (uint8_t layer = 0; layer < NUM_LAYERS_MAX; ++layer)
+		if (layer_state_is(layer))
+			next |= 1U << layer;
+	layer_state_set(0);
+	return next;
+}
+
+static layer_state_t transition(uint16_t keycode, bool pressed, layer_state_t state) {
+	layer_state_t layer = 1 << KEY_GET_LAYER(keycode);
+	switch (KEY_GET_OP(keycode)) {
+		case OP_LAYER_TAP:
+		case OP_ONESHOT_LAYER:
+			return pressed ? state | layer : state & ~layer;
+		case OP_LAYER_TOGGLE:
+			return pressed ? state ^ layer : state;
+	}
+	return user_transition(keycode, pressed, state);
+}
+
+static bool is_reachable(int state) {
+	return (reachable[state / 8] & (1U << (state % 8))) != 0;
+}
+
+static bool is_live(uint8_t layer, uint8_t row, uint8_t col) {
+	return (live[col][row] & (1U << layer)) && (!layer || keymaps[0][col][row] != KC_NO);
+}
+
+static void dump_layer(FILE* out, uint8_t layer, const uint8_t* remap) {
+	for (int col = 0; col < KEYBOARD_COLS_MAX; ++col) {
+		fprintf(out, "\t{");
+		for (int row = 0; row < KEYBOARD_ROWS; ++row) {
+			uint16_t kc = keymaps[layer][col][row];
+			if (!is_live(layer, row, col))
+				kc = layer ? KC_TRANSPARENT : KC_NO;
+			switch (KEY_GET_OP(kc)) {
+				case OP_LAYER_TAP:
+				case OP_LAYER_TOGGLE:
+				case OP_ONESHOT_LAYER:
+					kc = (kc & ~(0x1f << 8)) | (remap[KEY_GET_LAYER(kc)] << 8);
+			}
+			fprintf(out, " 0x%04x,", kc);
+		}
+		fprintf(out, " },\n");
+	}
+}
+
+int ko_analyze_keymap(FILE* out, bool dump) {
+	uint8_t count = MIN(keymap_layer_count, NUM_LAYERS_MAX);
+	layer_state_t all = (1U << count) - 1;
+	layer_state_t seen = 0;
+	uint8_t remap[NUM_LAYERS_MAX];
+	int states = 0, dead = 0;
+	bool changed;
+
+	memset(reachable, 0, sizeof(reachable));
+	memset(live, 0, sizeof(live));
+	reachable[0] = 1; // nothing toggled on
+
+	do {
+		changed = false;
+		for (int state = 0; state <= all; ++state) {
+			if (!is_reachable(state))
+				continue;
+			for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col) {
+				for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row) {
+					uint8_t layer;
+					uint16_t kc = resolve(1 | state, row, col, &layer); // layer 0 is the base
+					live[col][row] |= 1U << layer;
+					for (int pressed = 0; pressed < 2; ++pressed) {
+						layer_state_t next = transition(kc, pressed, state) & all;
+						if (!is_reachable(next)) {
+							reachable[next / 8] |= 1U << (next % 8);
+							changed = true;
+						}
+					}
+				}
+			}
+		}
+	} while (changed);
+
+	for (int state = 0; state <= all; ++state) {
+		if (is_reachable(state)) {
+			seen |= state;
+			++states;
+		}
+	}
+	seen |= 1;
+
+	for (uint8_t layer = 0; layer < count; ++layer) {
+		if (!(seen & (1U << layer))) {
+			fprintf(out, "layer %d is never active\n", layer);
+			continue;
+		}
+		for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col) {
+			for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row) {
+				uint16_t kc = keymaps[layer][col][row];
+				if (kc == KC_NO || kc == KC_TRANSPARENT || is_live(layer, row, col))
+					continue;
+				if (keymaps[0][col][row] == KC_NO)
+					fprintf(out, "layer %d row %d col %d (0x%04x) has no key in the base layout\n", layer, row, col, kc);
+				else
+					fprintf(out, "layer %d row %d col %d (0x%04x) is shadowed\n", layer, row, col, kc);
+				++dead;
+			}
+		}
+	}
+	fprintf(out, "%d reachable layer states, %d dead entries\n", states, dead);
+
+	if (dump) {
+		// Pruned table: unreachable layers dropped, dead entries cleared and
+		// layer actions renumbered. Layers switched from user code are not.
+		for (uint8_t layer = 0, next = 0; layer < count; ++layer)
+			remap[layer] = (seen & (1U << layer)) ? next++ : 0;
+		for (uint8_t layer = 0; layer < count; ++layer) {
+			if (!(seen & (1U << layer)))
+				continue;
+			fprintf(out, "[%d] = { // was layer %d\n", remap[layer], layer);
+			dump_layer(out, layer, remap);
+			fprintf(out, "},\n");
+		}
+	}
+	return dead;
+}
@@ -0,0 +1,9 @@
+// Host keymap analyzer (analyze.c), linked against the engine and a keymap.
+#pragma once
+#include <stdio.h>
+
+#include "ko_platform.h"
+
+// Reports unreachable layers and dead entries of keymaps to out, followed by
+// the pruned table if dump is set. Returns the number of dead entries.
+int ko_analyze_keymap(FILE* out, bool dump);
@@ -0,0 +1,11 @@
+// Driver for the keymap analyzer; build it with "make analyze KEYMAP=...".
+//   analyze          reports unreachable layers and dead entries
+//   analyze dump     also prints the pruned keymap table
+#include <string.h>
+
+#include "analyze.h"
+
+int main(int argc, char** argv) {
+	ko_analyze_keymap(stdout, argc > 1 && !strcmp(argv[1], "dump"));
+	return 0;
+}
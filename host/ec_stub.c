@@ -0,0 +1,321 @@
+// Stand-ins for the EC services the engine uses, for host tests and fuzzing.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chipset.h"
+#include "ec_stub.h"
+#include "host_command.h"
+#include "keyboard_8042_sharedlib.h"
+#include "keyboard_backlight.h"
+#include "keyboard_scan.h"
+#include "task.h"
+
+uint64_t host_time_us;
+
+struct keyboard_scan_config keyscan_config = {
+	.output_settle_us = 50,
+	.debounce_down_us = 9 * MSEC,
+	.debounce_up_us = 30 * MSEC,
+	.scan_period_us = 3 * MSEC,
+	.min_post_scan_delay_us = 1000,
+	.poll_timeout_us = 100 * MSEC,
+};
+char host_output[4096];
+bool host_output_muted;
+
+timestamp_t get_time(void) {
+	timestamp_t t;
+	t.val = host_time_us;
+	return t;
+}
+
+int __fls(uint32_t x) {
+	return 31 - __builtin_clz(x);
+}
+
+int strtoi(const char* nptr, char** endptr, int base) {
+	return (int)strtol(nptr, endptr, base);
+}
+
+void mutex_lock(struct mutex* mtx) {
+	if (mtx->locked) { // the host is single-threaded: this would deadlock on the EC
+		fprintf(stderr, "mutex locked twice\n");
+		abort();
+	}
+	mtx->locked = 1;
+}
+
+void mutex_unlock(struct mutex* mtx) {
+	mtx->locked = 0;
+}
+
+/// Output
+static void host_log(const char* format, ...) {
+	size_t used = strlen(host_output);
+	va_list args;
+
+	if (host_output_muted)
+		return;
+	va_start(args, format);
+	vsnprintf(host_output + used, sizeof(host_output) - used, format, args);
+	va_end(args);
+}
+
+void host_output_reset(void) {
+	host_output[0] = 0;
+}
+
+void host_expect_output(const char* expected, const char* file, int line) {
+	if (strcmp(host_output, expected)) {
+		fprintf(stderr, "%s:%d: expected \"%s\", got \"%s\"\n", file, line, expected, host_output);
+		abort();
+	}
+	host_output_reset();
+}
+
+// Scancodes are 0x00-0xff or 0xe000-0xe0ff; index the second set from 0x100
+static uint8_t host_made[0x200];
+
+static int host_scancode_index(uint16_t scancode) {
+	return (scancode & 0xff) | ((scancode >> 8) == 0xe0 ? 0x100 : 0);
+}
+
+int host_scancodes_made(void) {
+	int count = 0;
+	for (int i = 0; i < ARRAY_SIZE(host_made); ++i)
+		count += host_made[i];
+	return count;
+}
+
+void simulate_keyboard(uint16_t scancode, int is_pressed) {
+	int i = host_scancode_index(scancode);
+
+	host_log("%s%X ", is_pressed ? "+" : "-", scancode);
+	if (is_pressed) {
+		++host_made[i];
+	} else if (host_made[i]) {
+		--host_made[i];
+	} else {
+		fprintf(stderr, "break without make: %X after \"%s\"\n", scancode, host_output);
+		abort();
+	}
+}
+
+void simulate_scancodes_set2(uint8_t* scancodes, int len, int is_pressed) {
+	host_log("[set2 %d bytes] ", len);
+}
+
+int update_hid_key(enum media_key key, bool pressed) {
+	host_log("%shid%d ", pressed ? "+" : "-", key);
+	return EC_SUCCESS;
+}
+
+/// Task
+// keyboard_overdrive_task is played by host_advance_ms: it runs ko_task_step
+// host_task_latency_ms after it was woken or the wait it returned ran out.
+uint32_t host_task_latency_ms;
+static bool host_task_due;
+static uint64_t host_task_due_at;
+
+void task_wake(enum task_id id) {
+	if (!host_task_due || host_task_due_at > host_time_us) {
+		host_task_due = true;
+		host_task_due_at = host_time_us;
+	}
+}
+
+uint32_t task_wait_event(int timeout_us) {
+	fprintf(stderr, "keyboard_overdrive_task does not run on the host\n");
+	abort();
+}
+
+static void host_run_task(void) {
+	int wait = ko_task_step();
+
+	host_task_due = wait >= 0;
+	host_task_due_at = host_time_us + wait;
+}
+
+void host_advance_ms(uint32_t ms) {
+	uint64_t end = host_time_us + (uint64_t)ms * MSEC;
+
+	while (host_task_due && host_task_due_at + (uint64_t)host_task_latency_ms * MSEC <= end) {
+		host_time_us = MAX(host_time_us, host_task_due_at + (uint64_t)host_task_latency_ms * MSEC);
+		host_run_task();
+	}
+	host_time_us = end;
+}
+
+/// Scanner
+void host_scan(uint8_t row, uint8_t col, bool pressed) {
+	uint16_t make_code = 0;
+
+	if (matrix_callback_overload(row, col, pressed, &make_code) == T_NOT_INSTALLED)
+		host_log("[ec %d,%d %s] ", row, col, pressed ? "down" : "up");
+}
+
+void host_scan_batch(const uint8_t* changed, const uint8_t* state) {
+	if (matrix_batch_callback_overload(changed, state) == T_NOT_INSTALLED)
+		host_log("[ec batch] ");
+}
+
+/// Console
+char host_console_output[16384];
+
+static int host_console_vprintf(const char* format, va_list args) {
+	size_t used = strlen(host_console_output);
+
+	return vsnprintf(host_console_output + used, sizeof(host_console_output) - used, format, args);
+}
+
+static int host_console_printf(const char* format, ...) {
+	va_list args;
+	int ret;
+
+	va_start(args, format);
+	ret = host_console_vprintf(format, args);
+	va_end(args);
+	return ret;
+}
+
+int cputs(enum console_channel channel, const char* outstr) {
+	return host_console_printf("%s", outstr);
+}
+
+int cprints(enum console_channel channel, const char* format, ...) {
+	va_list args;
+	int ret;
+
+	va_start(args, format);
+	ret = host_console_vprintf(format, args);
+	va_end(args);
+	host_console_printf("\n");
+	return ret;
+}
+
+int cprintf(enum console_channel channel, const char* format, ...) {
+	va_list args;
+	int ret;
+
+	va_start(args, format);
+	ret = host_console_vprintf(format, args);
+	va_end(args);
+	return ret;
+}
+
+int ccprintf(const char* format, ...) {
+	va_list args;
+	int ret;
+
+	va_start(args, format);
+	ret = host_console_vprintf(format, args);
+	va_end(args);
+	return ret;
+}
+
+void cflush(void) {
+}
+
+/// BBRAM
+static uint8_t host_bbram[SYSTEM_BBRAM_IDX_COUNT];
+
+int system_get_bbram(enum system_bbram_idx idx, uint8_t* value) {
+	*value = host_bbram[idx];
+	return EC_SUCCESS;
+}
+
+int system_set_bbram(enum system_bbram_idx idx, uint8_t value) {
+	host_bbram[idx] = value;
+	return EC_SUCCESS;
+}
+
+/// Keyboard backlight and caps lock LED, for linking the board's keymap
+static int host_kblight;
+
+void gpio_set_level(enum gpio_signal signal, int value) {
+}
+
+int kblight_get(void) {
+	return host_kblight;
+}
+
+int kblight_set(int percent) {
+	host_kblight = percent;
+	return EC_SUCCESS;
+}
+
+void hx20_kblight_enable(int enable) {
+}
+
+/// Registration: DECLARE_HOOK, DECLARE_HOST_COMMAND, DECLARE_CONSOLE_COMMAND
+#define HOST_MAX_ENTRIES 8
+
+static void (*host_hooks[HOOK_TYPE_COUNT][HOST_MAX_ENTRIES])(void);
+static struct { uint16_t command; host_command_handler handler; } host_commands[HOST_MAX_ENTRIES];
+static struct { const char* name; host_console_handler handler; } host_consoles[HOST_MAX_ENTRIES];
+
+void host_register_hook(enum hook_type type, void (*routine)(void)) {
+	int i = 0;
+	while (host_hooks[type][i])
+		++i;
+	host_hooks[type][i] = routine;
+}
+
+void host_register_command(uint16_t command, host_command_handler handler) {
+	int i = 0;
+	while (host_commands[i].handler)
+		++i;
+	host_commands[i].command = command;
+	host_commands[i].handler = handler;
+}
+
+void host_register_console(const char* name, host_console_handler handler) {
+	int i = 0;
+	while (host_consoles[i].handler)
+		++i;
+	host_consoles[i].name = name;
+	host_consoles[i].handler = handler;
+}
+
+void host_run_hooks(enum hook_type type) {
+	for (int i = 0; i < HOST_MAX_ENTRIES && host_hooks[type][i]; ++i)
+		host_hooks[type][i]();
+}
+
+int host_command(uint16_t command, const void* params, int params_size, void* response, int response_max) {
+	struct host_cmd_handler_args args = {
+		.command = command,
+		.params = params,
+		.params_size = params_size,
+		.response = response,
+		.response_max = response_max,
+	};
+
+	for (int i = 0; i < HOST_MAX_ENTRIES && host_commands[i].handler; ++i) {
+		if (host_commands[i].command == command)
+			return host_commands[i].handler(&args);
+	}
+	return EC_RES_INVALID_PARAM;
+}
+
+int host_console(const char* line) {
+	char buf[64];
+	char* argv[8];
+	int argc = 0;
+
+	host_console_output[0] = 0;
+	snprintf(buf, sizeof(buf), "%s", line);
+	for (char* tok = strtok(buf, " "); tok && argc < ARRAY_SIZE(argv); tok = strtok(NULL, " "))
+		argv[argc++] = tok;
+	for (int i = 0; argc && i < HOST_MAX_ENTRIES && host_consoles[i].handler; ++i) {
+		if (!strcmp(host_consoles[i].name, argv[0]))
+			return host_consoles[i].handler(argc, argv);
+	}
+	return EC_ERROR_UNKNOWN;
+}
+
+void host_set_enabled(bool on) {
+	uint8_t param = on;
+	host_command(0x3E7F /* EC_CMD_SET_KEYBOARD_OVERDRIVE */, &param, sizeof(param), NULL, 0);
+}
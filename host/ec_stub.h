@@ -0,0 +1,36 @@
+// Test-facing side of the host stand-ins in ec_stub.c.
+#pragma once
+#include "common.h"
+#include "ko_platform.h"
+
+// get_time() returns this; tests move it forward themselves
+extern uint64_t host_time_us;
+#define host_set_time_ms(ms) (host_time_us = (uint64_t)(ms) * MSEC)
+
+// Everything sent to the 8042 and HID as text, e.g. "+12 +1C -1C -12 "
+extern char host_output[4096];
+extern bool host_output_muted; // leaves host_output alone; made scancodes are still counted
+void host_output_reset(void);
+// Aborts unless host_output is exactly expected, then resets it
+#define EXPECT_OUTPUT(expected) host_expect_output((expected), __FILE__, __LINE__)
+void host_expect_output(const char* expected, const char* file, int line);
+
+// Scancodes made and not broken yet. A make counts once per make, since
+// two sources (say OSM(LSFT) and KC_LSFT) can hold the same scancode.
+// A break with nothing made aborts: it means a press was lost.
+int host_scancodes_made(void);
+
+void host_set_enabled(bool on); // through EC_CMD_SET_KEYBOARD_OVERDRIVE
+// The scanner reporting an edge, at host_time_us
+void host_scan(uint8_t row, uint8_t col, bool pressed);
+// The scanner reporting a whole scan at once; one byte of rows per column
+void host_scan_batch(const uint8_t* changed, const uint8_t* state);
+// Moves time forward, running keyboard_overdrive_task whenever it is due
+void host_advance_ms(uint32_t ms);
+// How late the task gets to run, as on a busy EC
+extern uint32_t host_task_latency_ms;
+int host_command(uint16_t command, const void* params, int params_size, void* response, int response_max);
+// Runs a console command; what it printed is left in host_console_output
+int host_console(const char* line);
+extern char host_console_output[16384];
+void host_run_hooks(enum hook_type type);
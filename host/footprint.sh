@@ -0,0 +1,70 @@
+#!/bin/sh
+# One configuration of "make footprint": footprint.sh NAME "FLAGS"
+#
+# Builds the engine at -Os with $CC, and with ${CROSS_COMPILE}gcc too when it
+# is installed, then reads each symbol's bytes back with nm and each section's
+# total with size. Last, times the event path on this machine (footprint_main.c);
+# that is host wall time, comparable between configurations only.
+set -e
+name=$1
+flags=$2
+dir=$OUT/footprint-$name
+srcs="../keyboard_overdrive_lib.c ../ko_platform.c $KEYMAP"
+mkdir -p "$dir"
+
+# sizes DIR CC NM SIZE [CFLAGS...]: prints "symbol section bytes" lines
+sizes() {
+	d=$1; cc=$2; nm=$3; size=$4
+	shift 4
+	rm -rf "$d"
+	mkdir -p "$d"
+	for src in $srcs; do
+		$cc -std=gnu11 -Os -Iinclude -I.. -I. $flags "$@" -c "$src" -o "$d/$(basename "$src" .c).o"
+	done
+	$nm -S -t d "$d"/*.o | awk '
+		NF == 4 {
+			t = toupper($3)
+			if (t == "T" || t == "W") s = ".text"
+			else if (t == "R") s = ".rodata"
+			else if (t == "D" || t == "V") s = ".data"
+			else if (t == "B" || t == "C") s = ".bss"
+			else next
+			bytes[$4 " " s] += $2
+		}
+		END { for (k in bytes) print k, bytes[k] }'
+	$size -A "$d"/*.o | awk '
+		$1 ~ /^\.(text|rodata|data|bss)/ { split($1, p, "."); bytes["." p[2]] += $2 }
+		END { for (s in bytes) print "(total)", s, bytes[s] }'
+}
+
+sizes "$dir/host" "$CC" nm size > "$dir/host.txt"
+cross=-
+if command -v "${CROSS_COMPILE}gcc" > /dev/null; then
+	cross=${CROSS_COMPILE}gcc
+	sizes "$dir/cross" "$cross" "${CROSS_COMPILE}nm" "${CROSS_COMPILE}size" $CROSS_CFLAGS > "$dir/cross.txt"
+else
+	: > "$dir/cross.txt"
+fi
+
+# rows TOTALS: one line per symbol (TOTALS=0) or per section (TOTALS=1),
+# host bytes then cross bytes, largest first within a section
+rows() {
+	awk -v totals="$1" '
+		($1 == "(total)") != totals { next }
+		FNR == NR { host[$1 " " $2] = $3; next }
+		{ target[$1 " " $2] = $3; host[$1 " " $2] += 0 }
+		END {
+			for (k in host) {
+				split(k, f, " ")
+				printf "  %-40s %-8s %6d %6s\n", f[1], f[2], host[k], k in target ? target[k] : "-"
+			}
+		}' "$dir/host.txt" "$dir/cross.txt" | sort -b -k2,2 -k3,3nr -k1,1
+}
+
+echo "== $name: ${flags:-no options}"
+printf "  %-40s %-8s %6s %6s\n" symbol section host "$cross"
+rows 0
+rows 1
+
+$CC -std=gnu11 -Os -Wall -Iinclude -I.. -I. $flags -o "$dir/footprint_main" footprint_main.c ec_stub.c $srcs
+"$dir/footprint_main"
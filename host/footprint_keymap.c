@@ -0,0 +1,45 @@
+// Keymap for "make footprint" with FOOTPRINT_LAYERS layers (2 to
+// NUM_LAYERS_MAX), so the table and the event path are measured against the
+// layer count as well as the options. Every position has a key. Column 14
+// holds the tap-hold, one-shot and leader keys; column 15 holds MO() for each
+// layer above the base, which remaps the letter columns and leaves the rest
+// transparent.
+#include "common.h"
+#include "keyboard_overdrive.h"
+
+#ifndef FOOTPRINT_LAYERS
+#define FOOTPRINT_LAYERS 4
+#endif
+BUILD_ASSERT(FOOTPRINT_LAYERS >= 2 && FOOTPRINT_LAYERS <= NUM_LAYERS_MAX);
+
+#define FP_MO(layer) ((layer) < FOOTPRINT_LAYERS ? MO(layer) : KC_NO)
+
+const uint16_t keymaps[FOOTPRINT_LAYERS][KEYBOARD_COLS_MAX][KEYBOARD_ROWS] = {
+	[0] = {
+		[0 ... 13] = { KC_A, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G, KC_H },
+		[14] = { OSM(MOD_LSFT), OSL(1), LT(1, KC_SPC), MT(MOD_LCTL, KC_ESC),
+			KC_LSFT, ACT_MOD(MOD_LSFT, KC_X), TG(1), KC_LEAD },
+		[15] = { FP_MO(1), FP_MO(2), FP_MO(3), FP_MO(4), FP_MO(5), FP_MO(6), FP_MO(7), KC_NO },
+	},
+	[1 ... FOOTPRINT_LAYERS - 1] = {
+		[0 ... 13] = { KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7, KC_8 },
+		[14 ... 15] = { _______, _______, _______, _______, _______, _______, _______, _______ },
+	},
+};
+const uint8_t keymap_layer_count = sizeof(keymaps) / sizeof(keymaps[0]);
+
+#ifdef KO_LEADER
+const struct ko_leader_node leader_trie[] = {
+	[0] = LEADER_ROOT(1, 2),
+	[1] = LEADER_LEAF(KC_A, ACT_MOD(MOD_LGUI, KC_A)),
+	[2] = LEADER_LEAF(KC_B, ACT_MOD(MOD_LCTL, KC_B)),
+};
+const uint8_t leader_node_count = sizeof(leader_trie) / sizeof(leader_trie[0]);
+#endif
+
+#ifdef KO_KEY_OVERRIDES
+const struct ko_key_override key_overrides[] = {
+	[KC_B] = KEY_OVERRIDE(MOD_LSFT, MOD_LSFT, KC_DEL),
+};
+const uint16_t key_override_count = sizeof(key_overrides) / sizeof(key_overrides[0]);
+#endif
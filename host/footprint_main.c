@@ -0,0 +1,49 @@
+// Event-path timing for "make footprint": every matrix position is pressed
+// and released through the scanner callback, which runs process_matrix_event,
+// and only those calls are timed. The engine's tables, pressed-layer cache
+// included, belong to this process alone. This is wall time on the build
+// host, built with the host compiler: it compares configurations with each
+// other, and says nothing about EC cycles.
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ec_stub.h"
+
+#define FOOTPRINT_ROUNDS 16
+#define FOOTPRINT_GAP_MS 50 // past both debounce windows, short of the tap term
+
+static uint64_t elapsed_ns;
+static int events;
+
+static void timed_scan(uint8_t row, uint8_t col, bool pressed) {
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	host_scan(row, col, pressed);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed_ns += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 + end.tv_nsec - start.tv_nsec;
+	++events;
+	host_advance_ms(FOOTPRINT_GAP_MS);
+}
+
+int main(void) {
+	host_set_enabled(true);
+	host_output_muted = true;
+	for (int round = 0; round < FOOTPRINT_ROUNDS; ++round) {
+		for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col) {
+			for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row) {
+				timed_scan(row, col, true);
+				timed_scan(row, col, false);
+			}
+		}
+	}
+	host_advance_ms(KO_LEADER_TIMEOUT + KO_ONESHOT_TIMEOUT);
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made\n", host_scancodes_made());
+		return 1;
+	}
+	printf("  event path: %d events, %d ns/event on the build host (not EC cycles)\n",
+		events, (int)(elapsed_ns / events));
+	return 0;
+}
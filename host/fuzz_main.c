@@ -0,0 +1,66 @@
+// Driver for the fuzz target where libFuzzer isn't available.
+//   ko_fuzz_main FILE...   replays each file as one input (AFL++: @@)
+//   ko_fuzz_main -r N      runs N random inputs, mostly on the keys
+//                          test_keymap.c uses
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static uint8_t random_input[64];
+static int random_size;
+
+// Keeps the input that failed so it can be replayed
+static void save_random_input(int sig) {
+	FILE* f = fopen("fuzz-random-crash", "wb");
+	if (f) {
+		fwrite(random_input, 1, random_size, f);
+		fclose(f);
+		fprintf(stderr, "input saved to fuzz-random-crash\n");
+	}
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void run_random(long count) {
+	uint8_t* buf = random_input;
+
+	signal(SIGABRT, save_random_input);
+	srand(1);
+	for (long n = 0; n < count; ++n) {
+		int size = rand() % sizeof(random_input);
+		for (int i = 0; i < size; ++i) {
+			if (i & 1) // delay: mostly inside the tap term
+				buf[i] = (rand() % 4) ? rand() % 60 : rand() % 256;
+			else // key: columns 0-2, sometimes a wait
+				buf[i] = ((rand() % 8 == 0) ? 0x80 : 0) | (rand() % 24);
+		}
+		random_size = size;
+		LLVMFuzzerTestOneInput(buf, size);
+	}
+	printf("%ld random inputs passed\n", count);
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && !strcmp(argv[1], "-r")) {
+		run_random(atol(argv[2]));
+		return 0;
+	}
+	for (int i = 1; i < argc; ++i) {
+		static uint8_t buf[1 << 16];
+		FILE* f = fopen(argv[i], "rb");
+		size_t size;
+
+		if (!f) {
+			perror(argv[i]);
+			return 1;
+		}
+		size = fread(buf, 1, sizeof(buf), f);
+		fclose(f);
+		LLVMFuzzerTestOneInput(buf, size);
+	}
+	return 0;
+}
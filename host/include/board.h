@@ -0,0 +1,6 @@
+// Host stand-in for the board header.
+#pragma once
+#include "i2c_hid_mediakeys.h"
+
+#define KO_STATE_SNAPSHOT_BBRAM { SYSTEM_BBRAM_IDX_KEYBOARD_OVERDRIVE_STATE, \
+	SYSTEM_BBRAM_IDX_HOST_SPARE0, SYSTEM_BBRAM_IDX_HOST_SPARE1, SYSTEM_BBRAM_IDX_HOST_SPARE2 }
@@ -0,0 +1,4 @@
+// Host stand-in for the board and keymap sources; ec_stub.c ignores the LED.
+#pragma once
+enum gpio_signal { GPIO_CAP_LED_L };
+void gpio_set_level(enum gpio_signal signal, int value);
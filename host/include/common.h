@@ -0,0 +1,24 @@
+// Host stand-in for the EC's common.h: only what the engine uses.
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "board.h" // the EC pulls this in through config.h
+
+#define BUILD_ASSERT(cond) _Static_assert(cond, #cond)
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define CLAMP(x, lo, hi) MIN(MAX((x), (lo)), (hi))
+#define __ec_align1 __attribute__((packed))
+
+enum ec_error_list {
+	EC_SUCCESS = 0,
+	EC_ERROR_UNKNOWN = 1,
+	EC_ERROR_BUSY = 6,
+	EC_ERROR_PARAM1 = 11,
+	EC_ERROR_PARAM2 = 12,
+	EC_ERROR_PARAM_COUNT = 20,
+};
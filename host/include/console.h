@@ -0,0 +1,18 @@
+// Host stand-in: console output goes to stdout, commands are registered
+// with ec_stub.c so tests can run them with host_console().
+#pragma once
+#include "common.h"
+
+enum console_channel { CC_KEYBOARD };
+int cputs(enum console_channel channel, const char* outstr);
+int cprints(enum console_channel channel, const char* format, ...);
+int cprintf(enum console_channel channel, const char* format, ...);
+int ccprintf(const char* format, ...);
+void cflush(void);
+
+typedef int (*host_console_handler)(int argc, char** argv);
+void host_register_console(const char* name, host_console_handler handler);
+#define DECLARE_CONSOLE_COMMAND(name, routine, argdesc, help) \
+	static void __attribute__((constructor)) _register_console_##name(void) { \
+		host_register_console(#name, (routine)); \
+	}
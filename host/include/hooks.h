@@ -0,0 +1,16 @@
+// Host stand-in: hooks are registered with ec_stub.c and run by
+// host_run_hooks().
+#pragma once
+enum hook_type {
+	HOOK_INIT,
+	HOOK_CHIPSET_SUSPEND,
+	HOOK_CHIPSET_RESUME,
+	HOOK_TYPE_COUNT,
+};
+enum hook_priority { HOOK_PRIO_DEFAULT = 5000 };
+
+void host_register_hook(enum hook_type type, void (*routine)(void));
+#define DECLARE_HOOK(hooktype, routine, priority) \
+	static void __attribute__((constructor)) _register_hook_##routine(void) { \
+		host_register_hook((hooktype), (routine)); \
+	}
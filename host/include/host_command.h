@@ -0,0 +1,26 @@
+// Host stand-in: host commands are registered with ec_stub.c and run by
+// host_command().
+#pragma once
+#include "common.h"
+
+enum ec_status {
+	EC_RES_SUCCESS = 0,
+	EC_RES_INVALID_PARAM = 3,
+	EC_RES_ERROR = 4,
+};
+struct host_cmd_handler_args {
+	uint16_t command;
+	const void* params;
+	uint16_t params_size;
+	void* response;
+	uint16_t response_max;
+	uint16_t response_size;
+};
+#define EC_VER_MASK(version) (1UL << (version))
+
+typedef enum ec_status (*host_command_handler)(struct host_cmd_handler_args* args);
+void host_register_command(uint16_t command, host_command_handler handler);
+#define DECLARE_HOST_COMMAND(command, routine, version_mask) \
+	static void __attribute__((constructor)) _register_command_##routine(void) { \
+		host_register_command((command), (routine)); \
+	}
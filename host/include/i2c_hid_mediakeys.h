@@ -0,0 +1,8 @@
+// Host stand-in: HID keys go to the host output log (ec_stub.c).
+#pragma once
+enum media_key {
+	HID_KEY_DISPLAY_BRIGHTNESS_UP,
+	HID_KEY_DISPLAY_BRIGHTNESS_DN,
+	HID_KEY_AIRPLANE_MODE,
+};
+int update_hid_key(enum media_key key, bool pressed);
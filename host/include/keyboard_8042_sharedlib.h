@@ -0,0 +1,5 @@
+// Host stand-in: scancodes go to the host output log (ec_stub.c).
+#pragma once
+#include "common.h"
+void simulate_keyboard(uint16_t scancode, int is_pressed);
+void simulate_scancodes_set2(uint8_t* scancodes, int len, int is_pressed);
@@ -0,0 +1,5 @@
+// Host stand-in for the board's keymap; ec_stub.c keeps a level.
+#pragma once
+int kblight_get(void);
+int kblight_set(int percent);
+void hx20_kblight_enable(int enable);
@@ -0,0 +1,14 @@
+// Host stand-in: the scanner's configuration; ec_stub.c holds the EC's
+// default debounce windows.
+#pragma once
+#include "common.h"
+
+struct keyboard_scan_config {
+	uint16_t output_settle_us;
+	uint16_t debounce_down_us;
+	uint16_t debounce_up_us;
+	uint16_t scan_period_us;
+	uint32_t min_post_scan_delay_us;
+	uint32_t poll_timeout_us;
+};
+extern struct keyboard_scan_config keyscan_config;
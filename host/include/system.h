@@ -0,0 +1,15 @@
+// Host stand-in: BBRAM is a plain array in ec_stub.c.
+#pragma once
+#include "common.h"
+#include "console.h"
+#include "hooks.h"
+
+enum system_bbram_idx {
+	SYSTEM_BBRAM_IDX_KEYBOARD_OVERDRIVE_STATE,
+	SYSTEM_BBRAM_IDX_HOST_SPARE0,
+	SYSTEM_BBRAM_IDX_HOST_SPARE1,
+	SYSTEM_BBRAM_IDX_HOST_SPARE2,
+	SYSTEM_BBRAM_IDX_COUNT,
+};
+int system_get_bbram(enum system_bbram_idx idx, uint8_t* value);
+int system_set_bbram(enum system_bbram_idx idx, uint8_t value);
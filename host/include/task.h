@@ -0,0 +1,18 @@
+// Host stand-in: the host runs on one thread, so a mutex only checks that it
+// is never locked twice.
+// keyboard_overdrive_task itself is not run; host_advance_ms runs its steps.
+#pragma once
+#include "common.h"
+
+struct mutex {
+	int locked;
+};
+void mutex_lock(struct mutex* mtx);
+void mutex_unlock(struct mutex* mtx);
+
+enum task_id { TASK_ID_KEYOVER };
+void task_wake(enum task_id id);
+uint32_t task_wait_event(int timeout_us);
+
+// The EC declares task entry points from its task list
+void keyboard_overdrive_task(void* u);
@@ -0,0 +1,13 @@
+// Host stand-in: time is set by the test, see host_time_us in ec_stub.h.
+#pragma once
+#include "common.h"
+
+#define MSEC 1000
+typedef union {
+	uint64_t val;
+	struct {
+		uint32_t lo;
+		uint32_t hi;
+	} le;
+} timestamp_t;
+timestamp_t get_time(void);
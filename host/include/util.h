@@ -0,0 +1,7 @@
+// Host stand-in for the EC's util.h.
+#pragma once
+#include <strings.h>
+#include "common.h"
+
+int __fls(uint32_t x);
+int strtoi(const char* nptr, char** endptr, int base);
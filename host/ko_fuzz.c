@@ -0,0 +1,88 @@
+// libFuzzer/AFL++ target for the key engine; build it with host/Makefile.
+//
+// The input is a list of (key, delay) byte pairs. Each pair waits delay ms,
+// fires whatever timed out, then toggles the key at row key & 7, column
+// (key >> 3) & 15; with the top bit set the pair only waits. At the end every
+// held key is released and time runs past every timeout. Aborts unless:
+//  - both pressed-layer cache layouts agree (checked after every event)
+//  - no scancode is broken without being made (checked by ec_stub.c)
+//  - every make has had its break
+//  - no released key is still cached as pressed
+//  - only layers turned on by TG keys are left on, and no one-shot is pending
+
+// The checks need the engine's internals, so the library is built right here
+// with KO_FUZZ, which also builds the cache layout that isn't in use.
+#include "keyboard_overdrive_lib.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+
+#define KO_FUZZ_CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s failed after \"%s\"\n", __FILE__, __LINE__, #cond, host_output); \
+		abort(); \
+	} \
+} while (0)
+#define KO_FUZZ_SETTLE 5000 /* ms, longer than any timeout */
+
+static uint8_t fuzz_down[PACKED_CACHE_BYTES];
+
+static void fuzz_check_caches(void) {
+	for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col)
+		for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row)
+			KO_FUZZ_CHECK(get_pressed_layer(row, col) == fuzz_get_shadow_layer(row, col));
+}
+
+static void fuzz_toggle(uint8_t row, uint8_t col) {
+	uint8_t key = row * KEYBOARD_COLS_MAX + col;
+	struct key_record ev = {};
+
+	ev.event.key.row = row;
+	ev.event.key.col = col;
+	ev.event.pressed = !(fuzz_down[key / 8] & (1U << (key % 8)));
+	ev.event.time = host_time_us;
+	fuzz_down[key / 8] ^= 1U << (key % 8);
+	process_matrix_event(&ev, ev.event.time);
+	fuzz_check_caches();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size); // libFuzzer's entry point
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	host_output_reset();
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		host_time_us += data[i + 1] * MSEC;
+		ko_process_queue(host_time_us);
+		if (!(data[i] & 0x80))
+			fuzz_toggle(data[i] & 7, (data[i] >> 3) & 15);
+	}
+
+	for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row) {
+		for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col) {
+			uint8_t key = row * KEYBOARD_COLS_MAX + col;
+			if (fuzz_down[key / 8] & (1U << (key % 8)))
+				fuzz_toggle(row, col);
+		}
+	}
+	host_time_us += KO_FUZZ_SETTLE * MSEC;
+	ko_process_queue(host_time_us);
+
+	KO_FUZZ_CHECK(host_scancodes_made() == 0);
+	for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col)
+		for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row)
+			KO_FUZZ_CHECK(get_pressed_layer(row, col) == 0);
+
+	// Only TG keys leave layers on, and no one-shot outlives the settle
+	KO_FUZZ_CHECK((active_layers & ~toggled_layers) == 0);
+	KO_FUZZ_CHECK(oneshot_mods == 0 && oneshot_layers == 0);
+	KO_FUZZ_CHECK(oneshot_held_mods == 0 && oneshot_held_layers == 0);
+
+	// Start the next input from rest: TG layers would otherwise stay on
+	active_layers = 0;
+	toggled_layers = 0;
+	oneshot_held_mods = oneshot_used_mods = 0;
+	oneshot_held_layers = oneshot_used_layers = 0;
+	quick_tap_state = 0;
+	return 0;
+}
@@ -0,0 +1,88 @@
+// The keymap analyzer: what it counts as dead has to be what it clears from
+// the pruned table.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyze.h"
+
+static char* output;
+
+// Runs the analyzer, leaving what it printed in output
+static int analyze(bool dump) {
+	size_t size;
+	FILE* out;
+	int dead;
+
+	free(output);
+	out = open_memstream(&output, &size);
+	dead = ko_analyze_keymap(out, dump);
+	fclose(out);
+	return dead;
+}
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s failed; output:\n%s", __FILE__, __LINE__, #cond, output); \
+		abort(); \
+	} \
+} while (0)
+
+static int count_lines(const char* text, const char* needle) {
+	int n = 0;
+	for (const char* p = strstr(text, needle); p; p = strstr(p + 1, needle))
+		++n;
+	return n;
+}
+
+static int report_dead(void) {
+	const char* summary = strstr(output, "reachable layer states, ");
+	int dead = -1;
+
+	CHECK(summary && sscanf(summary, "reachable layer states, %d dead entries", &dead) == 1);
+	return dead;
+}
+
+static void test_report(void) {
+	int dead = analyze(false);
+
+	CHECK(strstr(output, "\n4 reachable layer states") != NULL);
+	CHECK(strstr(output, "layer 1 row 0 col 3 (0x0020) has no key in the base layout") != NULL);
+	CHECK(report_dead() == dead);
+	CHECK(dead == count_lines(output, "is shadowed") + count_lines(output, "has no key in the base layout"));
+}
+
+// Every dead entry is cleared in the dump, and no other key changes
+static void test_dump_matches_report(void) {
+	const char* p;
+	int dead, cleared = 0;
+
+	dead = analyze(true);
+	for (p = strstr(output, "// was layer "); p; p = strstr(p, "// was layer ")) {
+		int layer = atoi(p + strlen("// was layer "));
+
+		for (int col = 0; col < KEYBOARD_COLS_MAX; ++col) {
+			p = strchr(p, '{') + 1;
+			for (int row = 0; row < KEYBOARD_ROWS; ++row) {
+				uint16_t was = keymaps[layer][col][row];
+				uint16_t kc = strtoul(p, (char**)&p, 16);
+
+				p = strchr(p, ',') + 1;
+				if (kc == was)
+					continue;
+				CHECK(kc == (layer ? KC_TRANSPARENT : KC_NO));
+				if (was != KC_NO && was != KC_TRANSPARENT) // those only trade places
+					++cleared;
+			}
+		}
+	}
+	CHECK(dead > 0 && cleared == dead);
+}
+
+int main(void) {
+	test_report();
+	printf("ok test_report\n");
+	test_dump_matches_report();
+	printf("ok test_dump_matches_report\n");
+	return 0;
+}
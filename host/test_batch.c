@@ -0,0 +1,112 @@
+// matrix_batch_callback_overload: a scan with several changes has to send what
+// the same changes sent one by one would, in column then row order.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+
+static uint8_t matrix[KEYBOARD_COLS_MAX]; // the state the engine was last given
+static uint8_t changed[KEYBOARD_COLS_MAX];
+
+static void change(uint8_t row, uint8_t col) {
+	changed[col] ^= 1U << row;
+}
+
+static void scan(void) {
+	for (int col = 0; col < KEYBOARD_COLS_MAX; ++col)
+		matrix[col] ^= changed[col];
+	host_scan_batch(changed, matrix);
+	memset(changed, 0, sizeof(changed));
+}
+
+static void test_roll(void) {
+	change(1, 0); // KC_B
+	change(0, 0); // KC_A
+	change(1, 1); // KC_D
+	scan();
+	EXPECT_OUTPUT("+1C +32 +23 ");
+	host_advance_ms(30);
+	change(0, 0);
+	change(1, 1);
+	scan();
+	EXPECT_OUTPUT("-1C -23 ");
+	host_advance_ms(30);
+	change(1, 0);
+	scan();
+	EXPECT_OUTPUT("-32 ");
+}
+
+static void test_same_as_single(void) {
+	char batch[sizeof(host_output)];
+
+	change(0, 0);
+	change(5, 0); // MT(MOD_LCTL, KC_ESC)
+	scan();
+	host_advance_ms(KO_TAP_TERM + 10);
+	change(0, 0);
+	change(5, 0);
+	scan();
+	snprintf(batch, sizeof(batch), "%s", host_output);
+	host_output_reset();
+
+	host_advance_ms(1000);
+	host_scan(0, 0, true);
+	host_scan(5, 0, true);
+	host_advance_ms(KO_TAP_TERM + 10);
+	host_scan(0, 0, false);
+	host_scan(5, 0, false);
+	EXPECT_OUTPUT(batch);
+}
+
+static void test_layer_change_in_batch(void) {
+	change(7, 0); // TG(2)
+	scan();
+	host_advance_ms(30);
+	change(7, 0); // layer 2 goes on with this release...
+	change(1, 1); // ...so this comes from layer 2: KC_3
+	scan();
+	host_advance_ms(30);
+	change(1, 1);
+	scan();
+	EXPECT_OUTPUT("+26 -26 ");
+
+	change(7, 0);
+	scan();
+	change(7, 0);
+	scan();
+	change(1, 1); // layer 2 is off again: KC_D
+	scan();
+	change(1, 1);
+	scan();
+	EXPECT_OUTPUT("+23 -23 ");
+}
+
+static void test_disabled(void) {
+	host_set_enabled(false);
+	change(0, 0);
+	scan();
+	change(0, 0);
+	scan();
+	EXPECT_OUTPUT("[ec batch] [ec batch] ");
+	host_set_enabled(true);
+}
+
+#define RUN(test) do { \
+	test(); \
+	host_advance_ms(1000); \
+	EXPECT_OUTPUT(""); \
+	printf("ok %s\n", #test); \
+} while (0)
+
+int main(void) {
+	host_set_enabled(true);
+	RUN(test_roll);
+	RUN(test_same_as_single);
+	RUN(test_layer_change_in_batch);
+	RUN(test_disabled);
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made\n", host_scancodes_made());
+		return 1;
+	}
+	return 0;
+}
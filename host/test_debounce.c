@@ -0,0 +1,161 @@
+// KO_EAGER_DEBOUNCE against bouncing switches: presses go out on their first
+// edge, releases once the key has been up for KO_DEBOUNCE ms, and chatter in
+// between never reaches the host.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+#include "keyboard_scan.h"
+
+#define KEY_A 0, 0      // KC_A, scancode 1C
+#define KEY_B 1, 0      // KC_B, scancode 32
+#define KEY_MT_ESC 5, 0 // MT(MOD_LCTL, KC_ESC): 76 tapped, 14 held
+
+static void test_press_bounce(void) {
+	host_scan(KEY_A, true);
+	EXPECT_OUTPUT("+1C ");
+	for (int i = 0; i < 4; ++i) { // contact bounce right after the press
+		host_advance_ms(1);
+		host_scan(KEY_A, i & 1);
+	}
+	host_advance_ms(100);
+	EXPECT_OUTPUT("");
+
+	host_scan(KEY_A, false);
+	host_advance_ms(KO_DEBOUNCE - 1);
+	EXPECT_OUTPUT("");
+	host_advance_ms(1);
+	EXPECT_OUTPUT("-1C ");
+}
+
+static void test_release_bounce(void) {
+	host_scan(KEY_A, true);
+	host_advance_ms(100);
+	EXPECT_OUTPUT("+1C ");
+
+	host_scan(KEY_A, false);
+	host_advance_ms(1);
+	host_scan(KEY_A, true);
+	host_advance_ms(1);
+	host_scan(KEY_A, false); // the window starts over from here
+	host_advance_ms(KO_DEBOUNCE - 1);
+	EXPECT_OUTPUT("");
+	host_advance_ms(1);
+	EXPECT_OUTPUT("-1C ");
+}
+
+static void test_release_glitch(void) {
+	host_scan(KEY_A, true);
+	host_advance_ms(100);
+	host_scan(KEY_A, false); // a glitch while the key is held down
+	host_advance_ms(2);
+	host_scan(KEY_A, true);
+	host_advance_ms(100);
+	EXPECT_OUTPUT("+1C ");
+
+	host_scan(KEY_A, false);
+	host_advance_ms(KO_DEBOUNCE);
+	EXPECT_OUTPUT("-1C ");
+}
+
+static void test_short_press(void) {
+	host_scan(KEY_A, true);
+	host_advance_ms(2);
+	host_scan(KEY_A, false); // inside the press window
+	EXPECT_OUTPUT("+1C ");
+	host_advance_ms(KO_DEBOUNCE);
+	EXPECT_OUTPUT("-1C ");
+}
+
+static void test_keys_independent(void) {
+	host_scan(KEY_A, true);
+	host_advance_ms(1);
+	host_scan(KEY_B, true); // A is still in its window
+	EXPECT_OUTPUT("+1C +32 ");
+	host_advance_ms(50);
+	host_scan(KEY_A, false);
+	host_advance_ms(1);
+	host_scan(KEY_B, false);
+	host_advance_ms(KO_DEBOUNCE);
+	EXPECT_OUTPUT("-1C -32 ");
+}
+
+// The release is reported after the tapping term has passed, but it happened
+// before: the tap/hold decision has to follow the release edge.
+static void test_tap_hold_release_bounce(void) {
+	host_scan(KEY_MT_ESC, true);
+	host_advance_ms(KO_TAP_TERM - 3);
+	host_scan(KEY_MT_ESC, false);
+	host_advance_ms(1);
+	host_scan(KEY_MT_ESC, true);
+	host_advance_ms(1);
+	host_scan(KEY_MT_ESC, false); // last edge at KO_TAP_TERM - 1
+	host_advance_ms(KO_DEBOUNCE + KO_QUICK_TAP_TERM);
+	EXPECT_OUTPUT("+76 -76 ");
+
+	host_scan(KEY_MT_ESC, true);
+	host_advance_ms(KO_TAP_TERM + 1);
+	EXPECT_OUTPUT("+14 ");
+	host_scan(KEY_MT_ESC, false);
+	host_advance_ms(KO_DEBOUNCE);
+	EXPECT_OUTPUT("-14 ");
+}
+
+// Another key's edge must not fire the hold either while that release is
+// still held back.
+static void test_tap_hold_release_then_key(void) {
+	host_scan(KEY_MT_ESC, true);
+	host_advance_ms(KO_TAP_TERM - 2);
+	host_scan(KEY_MT_ESC, false);
+	host_advance_ms(3);
+	host_scan(KEY_A, true); // past the tapping term, inside the release window
+	EXPECT_OUTPUT("+1C ");
+	host_advance_ms(KO_DEBOUNCE);
+	EXPECT_OUTPUT("+76 -76 ");
+	host_scan(KEY_A, false);
+	host_advance_ms(KO_DEBOUNCE);
+	EXPECT_OUTPUT("-1C ");
+}
+
+static void test_scanner_debounce(void) {
+	BUILD_ASSERT(KO_DEBOUNCE * MSEC < 9 * MSEC); // below the stub's default
+	if (keyscan_config.debounce_down_us || keyscan_config.debounce_up_us) {
+		fprintf(stderr, "scanner debounce still on while enabled\n");
+		abort();
+	}
+
+	host_set_enabled(false);
+	if (keyscan_config.debounce_down_us != 9 * MSEC || keyscan_config.debounce_up_us != 30 * MSEC) {
+		fprintf(stderr, "board debounce not restored\n");
+		abort();
+	}
+	host_scan(KEY_A, true);
+	EXPECT_OUTPUT("[ec 0,0 down] ");
+	host_scan(KEY_A, false);
+	EXPECT_OUTPUT("[ec 0,0 up] ");
+	host_set_enabled(true);
+}
+
+#define RUN(test) do { \
+	test(); \
+	host_advance_ms(1000); \
+	EXPECT_OUTPUT(""); \
+	printf("ok %s\n", #test); \
+} while (0)
+
+int main(void) {
+	host_set_enabled(true);
+	RUN(test_press_bounce);
+	RUN(test_release_bounce);
+	RUN(test_release_glitch);
+	RUN(test_short_press);
+	RUN(test_keys_independent);
+	RUN(test_tap_hold_release_bounce);
+	RUN(test_tap_hold_release_then_key);
+	RUN(test_scanner_debounce);
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made\n", host_scancodes_made());
+		return 1;
+	}
+	return 0;
+}
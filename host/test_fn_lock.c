@@ -0,0 +1,108 @@
+// FN lock on the board's own keymap (ko_keymap.c) across suspend and resume.
+// FK_FN inverts _FN_ANY on both its press and its release, so FN lock, set
+// with FN+Esc (TG(_FN_ANY) on _FN_PRESSED), is toggled between two inversions.
+// Built with and without KO_STATE_SNAPSHOT: either way FN lock has to survive.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+
+#define FN_ANY 1      // _FN_ANY in ko_keymap.c
+#define FN_PRESSED 2  // _FN_PRESSED
+#define FK_FN (SAFE_AREA + 1)
+
+struct pos {
+	uint8_t row;
+	uint8_t col;
+};
+
+static struct pos find(uint8_t layer, uint16_t keycode) {
+	for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col)
+		for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row)
+			if (keymaps[layer][col][row] == keycode)
+				return (struct pos){ row, col };
+	fprintf(stderr, "keycode %04x not in layer %d\n", keycode, layer);
+	exit(1);
+}
+
+static struct pos fn, flck;
+
+static void scan(struct pos key, bool pressed) {
+	host_scan(key.row, key.col, pressed);
+	host_advance_ms(30);
+}
+
+static void toggle_fn_lock(void) {
+	scan(fn, true);
+	scan(flck, true);
+	scan(flck, false);
+	scan(fn, false);
+}
+
+static void expect_fn_lock(bool on) {
+	if (layer_state_is(FN_ANY) != on) {
+		fprintf(stderr, "FN lock %d, expected %d\n", layer_state_is(FN_ANY), on);
+		exit(1);
+	}
+}
+
+static void test_fn_lock_kept(void) {
+	toggle_fn_lock();
+	expect_fn_lock(true);
+	host_run_hooks(HOOK_CHIPSET_SUSPEND);
+	expect_fn_lock(false); // off for the caps LED
+	host_run_hooks(HOOK_CHIPSET_RESUME);
+	expect_fn_lock(true);
+	toggle_fn_lock();
+	expect_fn_lock(false);
+}
+
+#ifdef KO_STATE_SNAPSHOT
+static void test_fn_wakes(void) {
+	toggle_fn_lock();
+	host_run_hooks(HOOK_CHIPSET_SUSPEND);
+	scan(fn, true);
+	host_run_hooks(HOOK_CHIPSET_RESUME);
+	expect_fn_lock(false); // FN held with FN lock on
+	scan(fn, false);
+	expect_fn_lock(true);
+	toggle_fn_lock();
+	expect_fn_lock(false);
+}
+
+static void test_fn_lock_restored(void) {
+	static const enum system_bbram_idx bbram[] = KO_STATE_SNAPSHOT_BBRAM;
+	uint8_t snapshot[KO_SNAPSHOT_SIZE];
+
+	toggle_fn_lock();
+	host_run_hooks(HOOK_CHIPSET_SUSPEND);
+	for (int i = 0; i < KO_SNAPSHOT_SIZE; ++i)
+		system_get_bbram(bbram[i], &snapshot[i]);
+	host_run_hooks(HOOK_CHIPSET_RESUME);
+	toggle_fn_lock();
+	expect_fn_lock(false);
+	ko_snapshot_restore(snapshot); // as if RAM had been lost
+	expect_fn_lock(true);
+	toggle_fn_lock();
+	expect_fn_lock(false);
+}
+#endif
+
+#define RUN(test) do { \
+	test(); \
+	host_advance_ms(1000); \
+	host_output_reset(); \
+	printf("ok %s\n", #test); \
+} while (0)
+
+int main(void) {
+	fn = find(0, FK_FN);
+	flck = find(FN_PRESSED, TG(FN_ANY));
+	host_set_enabled(true);
+	RUN(test_fn_lock_kept);
+#ifdef KO_STATE_SNAPSHOT
+	RUN(test_fn_wakes);
+	RUN(test_fn_lock_restored);
+#endif
+	return 0;
+}
@@ -0,0 +1,118 @@
+// KO_HEATMAP: the counters read back in chunks through the host command, and
+// halve per group rather than wrap.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+#include "host_command.h"
+
+#define EC_CMD_KEYBOARD_OVERDRIVE_HEATMAP 0x3E7E
+#define CHUNK 32 // counters per response, so a read takes several commands
+
+static void tap(uint8_t row, uint8_t col) {
+	host_scan(row, col, true);
+	host_advance_ms(30);
+	host_scan(row, col, false);
+	host_advance_ms(30);
+}
+
+// Reads every counter the way the host does, clearing them as it goes if asked
+static void read_heatmap(uint16_t* counters, bool clear) {
+	uint16_t chunk[CHUNK];
+
+	for (int offset = 0; offset < KO_HEATMAP_COUNTERS; offset += CHUNK) {
+		uint8_t params[2] = { offset, clear };
+		int count = MIN(KO_HEATMAP_COUNTERS - offset, CHUNK);
+
+		if (host_command(EC_CMD_KEYBOARD_OVERDRIVE_HEATMAP, params, sizeof(params),
+				chunk, sizeof(chunk)) != EC_RES_SUCCESS) {
+			fprintf(stderr, "read at %d failed\n", offset);
+			exit(1);
+		}
+		memcpy(&counters[offset], chunk, count * sizeof(uint16_t));
+	}
+}
+
+static void expect_count(const uint16_t* counters, int idx, uint16_t expected) {
+	if (counters[idx] != expected) {
+		fprintf(stderr, "counter %d is %d, expected %d\n", idx, counters[idx], expected);
+		exit(1);
+	}
+}
+
+#define KEY(row, col) ((row) * KEYBOARD_COLS_MAX + (col))
+#define LAYER(layer) (KO_HEATMAP_KEYS + (layer))
+
+static void test_chunked_clear(void) {
+	uint16_t counters[KO_HEATMAP_COUNTERS];
+
+	tap(0, 0); // KC_A, in the first chunk
+	tap(7, 1); // MT(LALT, KC_W), in a later one
+	tap(7, 1);
+	read_heatmap(counters, true);
+	EXPECT_OUTPUT("+1C -1C +1D -1D +1D -1D ");
+	expect_count(counters, KEY(0, 0), 1);
+	expect_count(counters, KEY(7, 1), 2);
+	expect_count(counters, LAYER(0), 3);
+
+	// Clearing one chunk leaves the counts still to be read alone
+	tap(0, 0);
+	tap(7, 1);
+	uint8_t params[2] = { 0, true };
+	uint16_t chunk[CHUNK];
+	host_command(EC_CMD_KEYBOARD_OVERDRIVE_HEATMAP, params, sizeof(params), chunk, sizeof(chunk));
+	EXPECT_OUTPUT("+1C -1C +1D -1D ");
+	expect_count(chunk, KEY(0, 0), 1);
+	read_heatmap(counters, true);
+	expect_count(counters, KEY(0, 0), 0);
+	expect_count(counters, KEY(7, 1), 1);
+	expect_count(counters, LAYER(0), 2);
+
+	read_heatmap(counters, false);
+	for (int i = 0; i < KO_HEATMAP_COUNTERS; ++i)
+		expect_count(counters, i, 0);
+}
+
+static void test_saturation_halves_group(void) {
+	uint16_t counters[KO_HEATMAP_COUNTERS];
+
+	ko_heatmap[KEY(0, 0)] = UINT16_MAX;
+	ko_heatmap[KEY(7, 1)] = 101;
+	ko_heatmap[LAYER(0)] = 7;
+	tap(0, 0);
+	EXPECT_OUTPUT("+1C -1C ");
+	read_heatmap(counters, true);
+	expect_count(counters, KEY(0, 0), UINT16_MAX / 2 + 1);
+	expect_count(counters, KEY(7, 1), 50);
+	expect_count(counters, LAYER(0), 8); // the layer group has room left
+}
+
+static void test_bad_offset(void) {
+	uint8_t params[2] = { KO_HEATMAP_COUNTERS, false };
+	uint16_t chunk[CHUNK];
+
+	if (host_command(EC_CMD_KEYBOARD_OVERDRIVE_HEATMAP, params, sizeof(params),
+			chunk, sizeof(chunk)) != EC_RES_INVALID_PARAM) {
+		fprintf(stderr, "offset past the counters accepted\n");
+		exit(1);
+	}
+}
+
+#define RUN(test) do { \
+	test(); \
+	host_advance_ms(1000); \
+	EXPECT_OUTPUT(""); \
+	printf("ok %s\n", #test); \
+} while (0)
+
+int main(void) {
+	host_set_enabled(true);
+	RUN(test_chunked_clear);
+	RUN(test_saturation_halves_group);
+	RUN(test_bad_offset);
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made\n", host_scancodes_made());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,61 @@
+// KO_KEY_OVERRIDES: a trigger pressed with its modifiers sends the
+// replacement instead, and the trigger's release ends it.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+
+#define KEY_B 1, 0       // KC_B; shift+B sends KC_DEL (E071); OSL(1) on layer 2
+#define KEY_OSL 3, 0     // OSL(1)
+#define KEY_LSFT 6, 0    // KC_LSFT, scancode 12
+#define KEY_LT2 6, 1     // LT(2, KC_Q)
+
+static void test_override(void) {
+	host_scan(KEY_LSFT, true);
+	host_scan(KEY_B, true);
+	host_advance_ms(20);
+	host_scan(KEY_B, false);
+	host_scan(KEY_LSFT, false);
+	host_advance_ms(20);
+	EXPECT_OUTPUT("+12 -12 +E071 -E071 +12 -12 ");
+}
+
+// A one-shot tapped at the trigger's position, from another layer, times out
+// while the trigger is down: that timeout is not the trigger's release.
+static void test_timeout_at_trigger(void) {
+	host_scan(KEY_LT2, true);
+	host_advance_ms(KO_TAP_TERM + 10);
+	host_scan(KEY_B, true); // OSL(1)
+	host_scan(KEY_B, false);
+	host_scan(KEY_LT2, false);
+	host_advance_ms(20);
+
+	host_scan(KEY_OSL, true); // held: B does not use up the one-shot
+	host_scan(KEY_LSFT, true);
+	host_scan(KEY_B, true);
+	host_advance_ms(KO_ONESHOT_TIMEOUT);
+	EXPECT_OUTPUT("+12 -12 +E071 ");
+	host_scan(KEY_B, false);
+	host_scan(KEY_LSFT, false);
+	host_scan(KEY_OSL, false);
+	host_advance_ms(20);
+	EXPECT_OUTPUT("-E071 +12 -12 ");
+}
+
+#define RUN(test) do { \
+	test(); \
+	host_advance_ms(1000); \
+	EXPECT_OUTPUT(""); \
+	printf("ok %s\n", #test); \
+} while (0)
+
+int main(void) {
+	host_set_enabled(true);
+	RUN(test_override);
+	RUN(test_timeout_at_trigger);
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made\n", host_scancodes_made());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,44 @@
+// Keymap shared by the host tests and the fuzz target. Everything sits in
+// columns 0-2 so that small key numbers reach it.
+#include "common.h"
+#include "keyboard_overdrive.h"
+
+const uint16_t keymaps[][KEYBOARD_COLS_MAX][KEYBOARD_ROWS] = {
+	[0] = {
+		[0] = { KC_A, KC_B, OSM(MOD_LSFT), OSL(1), LT(1, KC_SPC), MT(MOD_LCTL, KC_ESC), KC_LSFT, TG(2) },
+		[1] = { KC_LEAD, KC_D, KC_P, ACT_MOD(MOD_LSFT, KC_X), OSM(MOD_RCTL), MO(2), LT(2, KC_Q), MT(MOD_LALT, KC_W) },
+		[2] = { MT(MOD_LALT, KC_C), MT(MOD_LALT, KC_E), MT(MOD_LALT, KC_F), MT(MOD_LALT, KC_G),
+			MT(MOD_LALT, KC_H), MT(MOD_LALT, KC_I), MT(MOD_LALT, KC_J), MT(MOD_LALT, KC_K) },
+	},
+	[1] = {
+		[0] = { KC_1, _______, _______, _______, _______, _______, _______, TG(1) },
+		[1] = { _______, _______, _______, _______, _______, _______, _______, _______ },
+		[2] = { _______, _______, _______, _______, _______, _______, _______, _______ },
+		[3] = { KC_5, _______, _______, _______, _______, _______, _______, _______ }, // no key in the base layout
+	},
+	[2] = {
+		[0] = { KC_2, OSL(1), _______, _______, _______, _______, _______, _______ },
+		[1] = { _______, KC_3, MT(MOD_LGUI, KC_4), _______, _______, _______, _______, _______ },
+		[2] = { _______, _______, _______, _______, _______, _______, _______, _______ },
+	},
+};
+const uint8_t keymap_layer_count = sizeof(keymaps) / sizeof(keymaps[0]);
+
+#ifdef KO_LEADER
+const struct ko_leader_node leader_trie[] = {
+	[0] = LEADER_ROOT(1, 2),
+	[1] = LEADER_LEAF(KC_P, ACT_MOD(MOD_LGUI, KC_P)),  // LEAD P
+	[2] = { KC_D, KC_X, 3, 1 },                        // LEAD D (times out to X)
+	[3] = LEADER_LEAF(KC_D, ACT_MOD(MOD_LCTL, KC_D)),  // LEAD D D
+};
+const uint8_t leader_node_count = sizeof(leader_trie) / sizeof(leader_trie[0]);
+#endif
+
+#ifdef KO_KEY_OVERRIDES
+const struct ko_key_override key_overrides[] = {
+	[KC_B] = KEY_OVERRIDE(MOD_LSFT, MOD_LSFT, KC_DEL),
+	[KC_D] = KEY_OVERRIDE(MOD_LCTL, 0, ACT_MOD(MOD_LALT, KC_X)),
+	[KC_P] = KEY_OVERRIDE(MOD_LSFT | MOD_LCTL, MOD_LCTL, KC_VOLU),
+};
+const uint16_t key_override_count = sizeof(key_overrides) / sizeof(key_overrides[0]);
+#endif
@@ -0,0 +1,47 @@
+// KO_LEADER: leader_trie is written by hand, so walk it the way the engine
+// does and check every index it would follow. Each child range has to lie in
+// the table, after its parent, and every node but the root has to belong to
+// exactly one range. Siblings need distinct plain keycodes, and a node
+// without children needs an action to tap.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+
+#define CHECK(cond, node) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: node %d: %s failed\n", __FILE__, __LINE__, (node), #cond); \
+		exit(1); \
+	} \
+} while (0)
+
+static void test_trie(void) {
+	uint8_t parents[256] = { 0 };
+
+	CHECK(leader_node_count > 0, 0);
+	CHECK(leader_trie[0].keycode == KC_NO && leader_trie[0].child_count > 0, 0);
+	for (int node = 0; node < leader_node_count; ++node) {
+		const struct ko_leader_node* n = &leader_trie[node];
+
+		if (!n->child_count) {
+			CHECK(node == 0 || n->action != KC_NO, node);
+			continue;
+		}
+		CHECK(n->first_child > node, node);
+		CHECK(n->first_child + n->child_count <= leader_node_count, node);
+		for (int i = n->first_child; i < n->first_child + n->child_count; ++i) {
+			CHECK(leader_trie[i].keycode != KC_NO && leader_trie[i].keycode == KEY_GET_KC(leader_trie[i].keycode), i);
+			CHECK(++parents[i] == 1, i);
+			for (int j = n->first_child; j < i; ++j)
+				CHECK(leader_trie[i].keycode != leader_trie[j].keycode, i);
+		}
+	}
+	for (int node = 1; node < leader_node_count; ++node)
+		CHECK(parents[node] == 1, node); // unreachable otherwise
+}
+
+int main(void) {
+	test_trie();
+	printf("ok test_trie\n");
+	return 0;
+}
@@ -0,0 +1,67 @@
+// One-shot keys: tapped, they apply to the next key only; held while another
+// key is pressed, they act like a plain hold. Each one-shot key is tracked on
+// its own.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+
+#define KEY_A 0, 0     // KC_A, scancode 1C
+#define KEY_D 1, 1     // KC_D, scancode 23 (B has a shift override)
+#define KEY_OSM_S 2, 0 // OSM(MOD_LSFT), scancode 12
+#define KEY_OSM_C 4, 1 // OSM(MOD_RCTL), scancode E014
+
+static void tap(uint8_t row, uint8_t col) {
+	host_scan(row, col, true);
+	host_advance_ms(20);
+	host_scan(row, col, false);
+	host_advance_ms(20);
+}
+
+static void test_tapped(void) {
+	tap(KEY_OSM_S);
+	tap(KEY_A);
+	tap(KEY_D);
+	EXPECT_OUTPUT("+12 +1C -12 -1C +23 -23 ");
+}
+
+static void test_held(void) {
+	host_scan(KEY_OSM_S, true);
+	host_advance_ms(20);
+	tap(KEY_A);
+	tap(KEY_D);
+	host_scan(KEY_OSM_S, false);
+	host_advance_ms(20);
+	EXPECT_OUTPUT("+12 +1C -1C +23 -23 -12 ");
+}
+
+// The tapped one-shot is used up by A; the held one stays until its release
+static void test_tapped_while_held(void) {
+	host_scan(KEY_OSM_S, true);
+	host_advance_ms(20);
+	tap(KEY_OSM_C);
+	tap(KEY_A);
+	tap(KEY_D);
+	host_scan(KEY_OSM_S, false);
+	host_advance_ms(20);
+	EXPECT_OUTPUT("+12 +E014 +1C -E014 -1C +23 -23 -12 ");
+}
+
+#define RUN(test) do { \
+	test(); \
+	host_advance_ms(1000); \
+	EXPECT_OUTPUT(""); \
+	printf("ok %s\n", #test); \
+} while (0)
+
+int main(void) {
+	host_set_enabled(true);
+	RUN(test_tapped);
+	RUN(test_held);
+	RUN(test_tapped_while_held);
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made\n", host_scancodes_made());
+		return 1;
+	}
+	return 0;
+}
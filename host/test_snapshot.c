@@ -0,0 +1,142 @@
+// KO_STATE_SNAPSHOT: suspend and resume leave live state alone while RAM
+// survives, and the BBRAM snapshot brings back latched state only.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+#include "ko_platform.h"
+
+// Like ko_keymap.c, which turns FN lock off for the caps LED
+void ko_suspend_user(void) {
+	layer_off(2);
+}
+
+static void tap(uint8_t row, uint8_t col) {
+	host_scan(row, col, true);
+	host_advance_ms(30);
+	host_scan(row, col, false);
+	host_advance_ms(30);
+}
+
+static void expect_layers(bool one, bool two) {
+	if (layer_state_is(1) != one || layer_state_is(2) != two) {
+		fprintf(stderr, "layer 1 %d, layer 2 %d; expected %d, %d\n",
+			layer_state_is(1), layer_state_is(2), one, two);
+		exit(1);
+	}
+}
+
+static void test_toggled_layer_back(void) {
+	tap(7, 0); // TG(2)
+	host_run_hooks(HOOK_CHIPSET_SUSPEND);
+	expect_layers(false, false);
+	host_run_hooks(HOOK_CHIPSET_RESUME);
+	expect_layers(false, true);
+	tap(1, 1); // KC_3
+	EXPECT_OUTPUT("+26 -26 ");
+	tap(7, 0);
+	expect_layers(false, false);
+}
+
+static void test_wake_press_kept(void) {
+	host_run_hooks(HOOK_CHIPSET_SUSPEND);
+	host_scan(5, 1, true); // MO(2) wakes the system
+	host_advance_ms(30);
+	host_run_hooks(HOOK_CHIPSET_RESUME);
+	expect_layers(false, true);
+	tap(1, 1); // KC_3
+	host_scan(5, 1, false);
+	host_advance_ms(30);
+	expect_layers(false, false);
+	tap(1, 1); // KC_D
+	EXPECT_OUTPUT("+26 -26 +23 -23 ");
+}
+
+static void test_wake_press_inverts(void) {
+	tap(7, 0); // TG(2): FN lock
+	host_run_hooks(HOOK_CHIPSET_SUSPEND);
+	layer_invert(2); // FN pressed to wake, as ko_keymap.c handles it
+	host_run_hooks(HOOK_CHIPSET_RESUME);
+	expect_layers(false, false); // FN held with FN lock on
+	layer_invert(2); // FN released
+	expect_layers(false, true);
+	tap(7, 0);
+	expect_layers(false, false);
+}
+
+static const enum system_bbram_idx bbram[] = KO_STATE_SNAPSHOT_BBRAM;
+
+static void test_held_layer_not_restored(void) {
+	uint8_t snapshot[KO_SNAPSHOT_SIZE];
+
+	tap(7, 0); // TG(2)
+	host_scan(4, 0, true); // LT(1, KC_SPC) held
+	host_advance_ms(KO_TAP_TERM + 10);
+	expect_layers(true, true);
+	host_run_hooks(HOOK_CHIPSET_SUSPEND);
+	for (int i = 0; i < KO_SNAPSHOT_SIZE; ++i)
+		system_get_bbram(bbram[i], &snapshot[i]);
+	host_scan(4, 0, false); // released while suspended
+	host_advance_ms(30);
+	host_run_hooks(HOOK_CHIPSET_RESUME);
+	expect_layers(false, true);
+
+	tap(7, 0);
+	expect_layers(false, false);
+	if (!ko_snapshot_restore(snapshot)) { // as if RAM had been lost
+		fprintf(stderr, "snapshot rejected\n");
+		exit(1);
+	}
+	expect_layers(false, true);
+	tap(7, 0);
+	expect_layers(false, false);
+}
+
+static void test_oneshot_restored(void) {
+	uint8_t snapshot[KO_SNAPSHOT_SIZE];
+
+	host_scan(2, 0, true); // OSM(MOD_LSFT)
+	host_scan(2, 0, false);
+	host_scan(4, 1, true); // OSM(MOD_RCTL)
+	host_scan(4, 1, false);
+	ko_snapshot_save(snapshot);
+	host_advance_ms(KO_ONESHOT_TIMEOUT + 10);
+	EXPECT_OUTPUT("+12 +E014 -12 -E014 ");
+
+	ko_snapshot_restore(snapshot);
+	EXPECT_OUTPUT("+12 +E014 ");
+	tap(0, 0); // used up by the next key
+	EXPECT_OUTPUT("+1C -12 -E014 -1C ");
+}
+
+static void test_stale_snapshot(void) {
+	const uint8_t snapshot[KO_SNAPSHOT_SIZE] = { 0x14, 0x04, 0x00, 0x00 }; // version 1, right checksum
+
+	if (ko_snapshot_restore(snapshot)) {
+		fprintf(stderr, "stale snapshot restored\n");
+		exit(1);
+	}
+	expect_layers(false, false);
+}
+
+#define RUN(test) do { \
+	test(); \
+	host_advance_ms(1000); \
+	EXPECT_OUTPUT(""); \
+	printf("ok %s\n", #test); \
+} while (0)
+
+int main(void) {
+	host_set_enabled(true);
+	RUN(test_toggled_layer_back);
+	RUN(test_wake_press_kept);
+	RUN(test_wake_press_inverts);
+	RUN(test_held_layer_not_restored);
+	RUN(test_oneshot_restored);
+	RUN(test_stale_snapshot);
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made\n", host_scancodes_made());
+		return 1;
+	}
+	return 0;
+}
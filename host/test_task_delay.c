@@ -0,0 +1,105 @@
+// Tap/hold, one-shot and leader decisions follow event time: replaying the
+// same key trace with keyboard_overdrive_task running late has to send
+// exactly what it sends when the task runs on time.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ec_stub.h"
+
+struct step {
+	uint16_t at; // ms from the start of the trace
+	uint8_t row;
+	uint8_t col;
+	bool pressed;
+};
+#define TAP(at, len, key) TAP_POS(at, len, key)
+#define TAP_POS(at, len, row, col) { (at), (row), (col), true }, { (at) + (len), (row), (col), false }
+
+// Positions in test_keymap.c
+#define KEY_A 0, 0      // KC_A
+#define KEY_OSM 2, 0    // OSM(MOD_LSFT)
+#define KEY_OSL 3, 0    // OSL(1)
+#define KEY_OSM_R 4, 1  // OSM(MOD_RCTL)
+#define KEY_LT 4, 0     // LT(1, KC_SPC)
+#define KEY_MT_CTL 5, 0 // MT(MOD_LCTL, KC_ESC)
+#define KEY_LEAD 0, 1   // KC_LEAD
+#define KEY_D 1, 1      // KC_D
+#define KEY_MT_ALT 7, 1 // MT(MOD_LALT, KC_W)
+
+static const struct step mt_tap[] = { TAP(0, 150, KEY_MT_CTL) };
+static const struct step mt_hold[] = { TAP(0, 250, KEY_MT_CTL) };
+static const struct step mt_tap_edge[] = { TAP(0, KO_TAP_TERM - 1, KEY_MT_CTL) };
+static const struct step mt_hold_edge[] = { TAP(0, KO_TAP_TERM, KEY_MT_CTL) };
+static const struct step mt_hold_key[] = { { 0, KEY_MT_CTL, true }, TAP(230, 30, KEY_A), { 300, KEY_MT_CTL, false } };
+static const struct step mt_roll[] = { { 0, KEY_MT_CTL, true }, { 100, KEY_MT_ALT, true }, { 190, KEY_MT_CTL, false }, { 350, KEY_MT_ALT, false } };
+static const struct step mt_quick_tap[] = { TAP(0, 50, KEY_MT_CTL), TAP(120, 400, KEY_MT_CTL) };
+static const struct step lt_hold_key[] = { { 0, KEY_LT, true }, TAP(210, 20, KEY_A), { 260, KEY_LT, false } };
+static const struct step lt_key_early[] = { { 0, KEY_LT, true }, TAP(150, 20, KEY_A), { 260, KEY_LT, false } };
+static const struct step osm_used[] = { TAP(0, 50, KEY_OSM), TAP(900, 20, KEY_A) };
+static const struct step osm_timeout[] = { TAP(0, 50, KEY_OSM), TAP(KO_ONESHOT_TIMEOUT + 60, 20, KEY_A) };
+static const struct step osm_tap_in_hold[] = { { 0, KEY_OSM, true }, TAP(50, 30, KEY_OSM_R), TAP(150, 30, KEY_A), TAP(250, 30, KEY_D), { 400, KEY_OSM, false } };
+static const struct step osl_timeout[] = { TAP(0, 50, KEY_OSL), TAP(KO_ONESHOT_TIMEOUT + 80, 20, KEY_A) };
+#ifdef KO_LEADER
+static const struct step leader_timeout[] = { TAP(0, 30, KEY_LEAD), TAP(100, 30, KEY_D), TAP(KO_LEADER_TIMEOUT + 200, 30, KEY_D) };
+static const struct step leader_done[] = { TAP(0, 30, KEY_LEAD), TAP(100, 30, KEY_D), TAP(900, 30, KEY_D) };
+#endif
+
+#define TRACE(steps) { #steps, steps, ARRAY_SIZE(steps) }
+static const struct {
+	const char* name;
+	const struct step* steps;
+	int count;
+} traces[] = {
+	TRACE(mt_tap), TRACE(mt_hold), TRACE(mt_tap_edge), TRACE(mt_hold_edge),
+	TRACE(mt_hold_key), TRACE(mt_roll), TRACE(mt_quick_tap),
+	TRACE(lt_hold_key), TRACE(lt_key_early),
+	TRACE(osm_used), TRACE(osm_timeout), TRACE(osm_tap_in_hold), TRACE(osl_timeout),
+#ifdef KO_LEADER
+	TRACE(leader_timeout), TRACE(leader_done),
+#endif
+};
+
+static const uint32_t latencies[] = { 1, 3, 20, 150, KO_ONESHOT_TIMEOUT - 1 };
+#define SETTLE_MS (3 * KO_ONESHOT_TIMEOUT) // past every timeout, however late the task is
+
+static void replay(const struct step* steps, int count, uint32_t latency_ms, char* out, size_t size) {
+	uint32_t now = 0;
+
+	host_task_latency_ms = latency_ms;
+	host_output_reset();
+	for (int i = 0; i < count; ++i) {
+		host_advance_ms(steps[i].at - now);
+		now = steps[i].at;
+		host_scan(steps[i].row, steps[i].col, steps[i].pressed);
+	}
+	host_advance_ms(SETTLE_MS);
+	snprintf(out, size, "%s", host_output);
+	host_output_reset();
+	if (host_scancodes_made()) {
+		fprintf(stderr, "%d scancodes still made after \"%s\"\n", host_scancodes_made(), out);
+		abort();
+	}
+}
+
+int main(void) {
+	char on_time[256], late[256];
+	int failed = 0;
+
+	host_set_enabled(true);
+	for (int t = 0; t < ARRAY_SIZE(traces); ++t) {
+		bool same = true;
+
+		replay(traces[t].steps, traces[t].count, 0, on_time, sizeof(on_time));
+		for (int l = 0; l < ARRAY_SIZE(latencies); ++l) {
+			replay(traces[t].steps, traces[t].count, latencies[l], late, sizeof(late));
+			if (strcmp(on_time, late)) {
+				fprintf(stderr, "%s, task %u ms late: \"%s\", on time: \"%s\"\n",
+					traces[t].name, latencies[l], late, on_time);
+				same = false;
+			}
+		}
+		printf("%s %-16s %s\n", same ? "ok" : "FAIL", traces[t].name, on_time);
+		failed |= !same;
+	}
+	return failed;
+}
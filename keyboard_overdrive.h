@@ -5,14 +5,18 @@
 #define NUM_LAYERS_MAX 8
 #define LAYER_BITS 3
 #define KO_TAP_TERM 200 /* ms */
+#define KO_QUICK_TAP_TERM KO_TAP_TERM /* ms, 0 disables quick tap */
+#define KO_ONESHOT_TIMEOUT 1000 /* ms */
+#define KO_DEBOUNCE 5 /* ms, only with KO_EAGER_DEBOUNCE */
+#define KO_LEADER_TIMEOUT 1000 /* ms, only with KO_LEADER */
 
 enum _opcode {
 	OP_NONE         = 0b000, // OP 3, MOD 5, KEY 8
 	OP_MOD_TAP      = 0b001, // OP 3, MOD 5, KEY 8
 	OP_LAYER_TAP    = 0b010, // OP 3, LAY 5, KEY 8, +press -release
 	OP_LAYER_TOGGLE = 0b011, // OP 3, LAY 5, ___ 8, toggles on release
-			//0b100
-			//0b101
+	OP_ONESHOT_MOD  = 0b100, // OP 3, MOD 5, ___ 8, arms mods for the next key
+	OP_ONESHOT_LAYER= 0b101, // OP 3, LAY 5, ___ 8, arms layer for the next key
 			//0b110
 	OP_SPECIAL      = 0b111
 };
@@ -34,6 +38,8 @@ enum _modifier {
 #define ACT_MOD_TAP(mod, key) ACT(OP_MOD_TAP, ((mod)&0x1f)<<8|(key))
 #define ACT_LAYER_TAP(lay, key) ACT(OP_LAYER_TAP, ((lay)&0x1f)<<8|(key))
 #define ACT_LAYER_TOGGLE(lay) ACT(OP_LAYER_TOGGLE, ((lay)&0x1f)<<8)
+#define ACT_ONESHOT_MOD(mod) ACT(OP_ONESHOT_MOD, ((mod)&0x1f)<<8)
+#define ACT_ONESHOT_LAYER(lay) ACT(OP_ONESHOT_LAYER, ((lay)&0x1f)<<8)
 #define KEY_GET_OP(kv) (((kv)>>13)&0x7)
 #define KEY_GET_LAYER(kv) (((kv)>>8)&0x1f)
 #define KEY_GET_KC(kv) ((kv)&0xff)
@@ -45,10 +51,13 @@ enum _modifier {
 #define LT(layer, kc) ACT_LAYER_TAP(layer, kc)
 #define TG(layer) ACT_LAYER_TOGGLE(layer)
 #define MT(mod, kc) ACT_MOD_TAP(mod, kc)
+#define OSM(mod) ACT_ONESHOT_MOD(mod)
+#define OSL(layer) ACT_ONESHOT_LAYER(layer)
 
 enum _keycode {
 	KC_NO = 0,
 	KC_TRANSPARENT = 0xFFFF, // OP_SPECIAL | 0x1FFF
+	KC_LEAD        = 0xE001, // OP_SPECIAL | 0x0001, only with KO_LEADER
 	KC_A = 0x1,
 	KC_B,
 	KC_C,
@@ -284,6 +293,7 @@ uint8_t layer_state_set_kb(uint8_t state);
 uint8_t layer_state_set_user(uint8_t state);
 
 extern const uint16_t keymaps[][KEYBOARD_COLS_MAX][KEYBOARD_ROWS];
+extern const uint8_t keymap_layer_count; // number of layers in keymaps
 
 struct key_pos {
 	uint8_t row;
@@ -293,6 +303,7 @@ struct key_pos {
 struct key_event {
 	struct key_pos key;
 	bool pressed;
+	uint32_t time; // microseconds (wrapping), stamped when the matrix reported it
 };
 
 struct key_tap {
@@ -306,6 +317,52 @@ typedef struct key_record {
 
 // tap.count is 1 when the tap event fired
 // tap.count is 0 when the hold event fired
+// For one-shot keys, a release with tap.count 1 means the armed one-shot timed out
+
+// Leader sequences (KO_LEADER) live in flash as a trie. Node 0 is the root
+// and the children of every node are contiguous, starting at first_child.
+// Each key typed after KC_LEAD moves to the child with a matching keycode;
+// reaching a node without children taps its action. If the leader times out
+// on an inner node, that node's action (if any) is tapped instead.
+//
+// const struct ko_leader_node leader_trie[] = {
+//	[0] = LEADER_ROOT(1, 2),
+//	[1] = LEADER_LEAF(KC_P, ACT_MOD(MOD_LGUI, KC_P)),  // LEAD P
+//	[2] = LEADER_NODE(KC_D, 3, 1),                     // LEAD D ...
+//	[3] = LEADER_LEAF(KC_D, ACT_MOD(MOD_LCTL, KC_D)),  // LEAD D D
+// };
+// const uint8_t leader_node_count = sizeof(leader_trie) / sizeof(leader_trie[0]);
+struct ko_leader_node {
+	uint16_t keycode; // key that selects this node from its parent
+	uint16_t action;  // keycode to tap when the sequence ends here
+	uint8_t first_child;
+	uint8_t child_count;
+};
+#define LEADER_ROOT(first, count) { KC_NO, KC_NO, (first), (count) }
+#define LEADER_NODE(kc, first, count) { (kc), KC_NO, (first), (count) }
+#define LEADER_LEAF(kc, act) { (kc), (act), 0, 0 }
+extern const struct ko_leader_node leader_trie[];
+extern const uint8_t leader_node_count; // nodes in leader_trie, for host/test_leader_trie.c
+
+// Key overrides (KO_KEY_OVERRIDES) replace a plain keycode while modifiers
+// are held. The table is indexed by the trigger keycode. An entry applies
+// when every mod in mods is held, on either side; the suppressed mods are
+// lifted while the replacement is down and put back afterwards. Pressing
+// any other key ends the override early.
+//
+// const struct ko_key_override key_overrides[] = {
+//	[KC_BS]   = KEY_OVERRIDE(MOD_LSFT, MOD_LSFT, KC_DEL),  // Shift+Backspace: Delete
+//	[KC_PGUP] = KEY_OVERRIDE(MOD_LCTL, MOD_LCTL, KC_VOLU), // Ctrl+PgUp: Volume Up
+// };
+// const uint16_t key_override_count = sizeof(key_overrides) / sizeof(key_overrides[0]);
+struct ko_key_override {
+	uint8_t mods;         // MOD_ bits without the side
+	uint8_t suppressed;   // MOD_ bits without the side
+	uint16_t replacement; // plain keycode, may carry ACT_MOD mods
+};
+#define KEY_OVERRIDE(mods, suppressed, kc) { (mods) & 0xf, (suppressed) & 0xf, (kc) }
+extern const struct ko_key_override key_overrides[];
+extern const uint16_t key_override_count; // entries in key_overrides
 
 bool process_record_user(uint16_t keycode, keyrecord_t* record);
 bool process_record_kb(uint16_t keycode, keyrecord_t* record);
@@ -4,48 +4,113 @@
 
 static layer_state_t base_layers   = 0b00000001;
 static layer_state_t active_layers = 0b00000000;
-
-// This is used to cache which layer a pressed key came from
-#ifdef KO_COMPRESSED_CACHE
-// KO_COMPRESSED_CACHE costs 128 bytes of flash but saves 80 bytes of RAM.
-// Uncompressed table: 128 bytes (RAM)
-//   Compressed table: 48  bytes (RAM)
-//       Bitwise code: 128 bytes extra (Flash)
-uint8_t act_pressed_layers[(KEYBOARD_COLS_MAX * KEYBOARD_ROWS + 7)/8][LAYER_BITS] = {{0}};
-
-static void set_pressed_layer(uint8_t row, uint8_t col, uint8_t layer) {
+// Layers latched on by TG keys: flipped on each TG press rather than copied
+// from the layer state, since keys that invert a layer around TG (the board's
+// FN key) would otherwise leave the latch looking off. A momentary or
+// one-shot layer turning off on its own release clears the latch with it.
+static layer_state_t toggled_layers = 0;
+
+// One-shot modifiers and layers stay applied until the next non-modifier key
+static uint8_t       oneshot_mods   = 0; // mods sent by one-shot keys and not released yet; left in the low nibble, right in the high
+static layer_state_t oneshot_layers = 0; // layers turned on by one-shot keys
+// Per one-shot, by the same bits: its key is physically down, and another key
+// was pressed while it was (so its release acts like the end of a hold)
+static uint8_t       oneshot_held_mods   = 0;
+static layer_state_t oneshot_held_layers = 0;
+static uint8_t       oneshot_used_mods   = 0;
+static layer_state_t oneshot_used_layers = 0;
+
+// This is used to cache which layer a pressed key came from.
+// Both layouts are built under KO_FUZZ, where host/ko_fuzz.c checks one
+// against the other.
+#define PACKED_CACHE_BYTES ((KEYBOARD_COLS_MAX * KEYBOARD_ROWS + 7)/8)
+
+#if defined(KO_COMPRESSED_CACHE) || defined(KO_FUZZ)
+static void packed_set_pressed_layer(uint8_t cache[][LAYER_BITS], uint8_t row, uint8_t col, uint8_t layer) {
 	uint8_t keyNum = row * KEYBOARD_COLS_MAX + col;
 	int cidx = keyNum / 8;
 	int rbit = keyNum % 8;
 	for(int i = 0; i < LAYER_BITS; ++i) {
-		act_pressed_layers[cidx][i] ^= (-((layer & (1U << i)) != 0) ^ act_pressed_layers[cidx][i]) & (1U << rbit);
+		cache[cidx][i] ^= (-((layer & (1U << i)) != 0) ^ cache[cidx][i]) & (1U << rbit);
 	}
 }
 
-static uint8_t get_pressed_layer(uint8_t row, uint8_t col) {
+static uint8_t packed_get_pressed_layer(uint8_t cache[][LAYER_BITS], uint8_t row, uint8_t col) {
 	uint8_t keyNum = row * KEYBOARD_COLS_MAX + col;
 	int cidx = keyNum / 8;
 	int rbit = keyNum % 8;
 	uint8_t layer = 0;
 	for(int i = 0; i < LAYER_BITS; ++i) {
-		layer |= ((act_pressed_layers[cidx][i] & (1U << rbit)) != 0) << i;
+		layer |= ((cache[cidx][i] & (1U << rbit)) != 0) << i;
 	}
 	return layer;
 }
+#endif
+
+#if !defined(KO_COMPRESSED_CACHE) || defined(KO_FUZZ)
+static void plain_set_pressed_layer(uint8_t cache[][KEYBOARD_ROWS], uint8_t row, uint8_t col, uint8_t layer) {
+	cache[col][row] = layer;
+}
+
+static uint8_t plain_get_pressed_layer(uint8_t cache[][KEYBOARD_ROWS], uint8_t row, uint8_t col) {
+	return cache[col][row];
+}
+#endif
+
+#ifdef KO_COMPRESSED_CACHE
+// KO_COMPRESSED_CACHE packs the table into 48 bytes of RAM instead of 128,
+// for bitwise code in flash. "make -C host footprint" measures both sides.
+uint8_t act_pressed_layers[PACKED_CACHE_BYTES][LAYER_BITS] = {{0}};
+#ifdef KO_FUZZ
+static uint8_t fuzz_shadow_layers[KEYBOARD_COLS_MAX][KEYBOARD_ROWS];
+#define fuzz_get_shadow_layer(row, col) plain_get_pressed_layer(fuzz_shadow_layers, (row), (col))
+#endif
+
+static void set_pressed_layer(uint8_t row, uint8_t col, uint8_t layer) {
+	packed_set_pressed_layer(act_pressed_layers, row, col, layer);
+#ifdef KO_FUZZ
+	plain_set_pressed_layer(fuzz_shadow_layers, row, col, layer);
+#endif
+}
+
+static uint8_t get_pressed_layer(uint8_t row, uint8_t col) {
+	return packed_get_pressed_layer(act_pressed_layers, row, col);
+}
 #else
 uint8_t act_pressed_layers[KEYBOARD_COLS_MAX][KEYBOARD_ROWS] = {{0}};
+#ifdef KO_FUZZ
+static uint8_t fuzz_shadow_layers[PACKED_CACHE_BYTES][LAYER_BITS];
+#define fuzz_get_shadow_layer(row, col) packed_get_pressed_layer(fuzz_shadow_layers, (row), (col))
+#endif
+
 static void set_pressed_layer(uint8_t row, uint8_t col, uint8_t layer) {
-	act_pressed_layers[col][row] = layer;
+	plain_set_pressed_layer(act_pressed_layers, row, col, layer);
+#ifdef KO_FUZZ
+	packed_set_pressed_layer(fuzz_shadow_layers, row, col, layer);
+#endif
 }
 
 static uint8_t get_pressed_layer(uint8_t row, uint8_t col) {
-	return act_pressed_layers[col][row];
+	return plain_get_pressed_layer(act_pressed_layers, row, col);
 }
 #endif
 
-static uint16_t get_keycode_at_pos(uint8_t row, uint8_t col, uint8_t* layer) {
-	layer_state_t layers = base_layers | active_layers;
+#ifdef KO_HEATMAP
+// Saturating counters: when one would overflow, its whole group (keys or
+// layers) is halved so relative frequencies are kept.
+// 256 bytes for keys + 16 bytes for layers (RAM)
+uint16_t ko_heatmap[KO_HEATMAP_COUNTERS];
+
+static void heatmap_count(uint16_t* counters, int n, int idx) {
+	if (counters[idx] == UINT16_MAX) {
+		for (int i = 0; i < n; ++i)
+			counters[i] >>= 1;
+	}
+	++counters[idx];
+}
+#endif
 
+static uint16_t get_keycode_at_pos(layer_state_t layers, uint8_t row, uint8_t col, uint8_t* layer) {
 	while(layers) {
 		int i = ko_topmost_active_layer(layers); // first non-zero bit = highest active layer
 		uint16_t kc = keymaps[i][col][row];
@@ -90,6 +155,327 @@ bool layer_state_is(uint8_t layer) {
 	return layer_state_cmp(active_layers, layer);
 }
 
+/// REGION: One-shot Keys
+static bool is_modifier_key(uint16_t keycode) {
+	switch (KEY_GET_OP(keycode)) {
+		case OP_NONE:
+			switch (KEY_GET_KC(keycode)) {
+				case KC_LCTL: case KC_LALT: case KC_LSFT: case KC_LGUI:
+				case KC_RCTL: case KC_RALT: case KC_RSFT: case KC_RGUI:
+					return true;
+			}
+			return false;
+		case OP_MOD_TAP:
+		case OP_LAYER_TAP:
+			return KEY_GET_KC(keycode) == KC_NO; // held-only; the tap side is a real key
+		case OP_LAYER_TOGGLE:
+		case OP_ONESHOT_MOD:
+		case OP_ONESHOT_LAYER:
+			return true;
+		case OP_SPECIAL:
+			return keycode == KC_LEAD; // one-shots carry over to the leader action
+	}
+	return false;
+}
+
+// A 5-bit MOD_ value can't hold left and right mods at once, so one-shots
+// track each side separately.
+static uint8_t oneshot_mod_bits(uint8_t mods) {
+	return (mods & 0b01111) << ((mods & 0b10000) ? 4 : 0);
+}
+
+static void oneshot_send_mods(uint8_t mods, struct key_record* record) {
+	if (mods & 0x0f)
+		ko_send_modifiers(mods & 0x0f, record);
+	if (mods & 0xf0)
+		ko_send_modifiers(0b10000 | (mods >> 4), record);
+}
+
+static void oneshot_release(uint8_t mods, layer_state_t layers) {
+	struct key_record release = {};
+	mods &= oneshot_mods;
+	layers &= oneshot_layers;
+	oneshot_send_mods(mods, &release);
+	oneshot_mods &= ~mods;
+	if (layers) {
+		oneshot_layers &= ~layers;
+		toggled_layers &= ~layers;
+		layer_state_set(active_layers & ~layers);
+	}
+}
+
+// Called after a key press has been sent. The first non-modifier key turns
+// the one-shots whose keys are still held into regular holds, and consumes
+// the ones that were tapped.
+static void oneshot_consume(uint16_t keycode) {
+	uint8_t mods;
+	layer_state_t layers;
+
+	if (is_modifier_key(keycode))
+		return;
+	oneshot_used_mods |= oneshot_held_mods;
+	oneshot_used_layers |= oneshot_held_layers;
+	mods = oneshot_mods & ~oneshot_held_mods;
+	layers = oneshot_layers & ~oneshot_held_layers;
+	if (mods || layers) {
+		oneshot_release(mods, layers);
+		// their timeouts have nothing left to do; free the queue slots now
+		ko_cancel_timed_events(OP_ONESHOT_MOD);
+		ko_cancel_timed_events(OP_ONESHOT_LAYER);
+	}
+}
+
+static void process_oneshot(uint16_t keycode, struct key_record* record) {
+	uint8_t mods = 0;
+	layer_state_t layers = 0;
+
+	if (KEY_GET_OP(keycode) == OP_ONESHOT_MOD)
+		mods = oneshot_mod_bits(KEY_GET_MOD(keycode));
+	else
+		layers = 1 << KEY_GET_LAYER(keycode);
+
+	if (record->event.pressed) {
+		ko_cancel_tap_hold_event(keycode, record); // drop a pending timeout from an earlier tap
+		oneshot_send_mods(mods & ~oneshot_mods, record); // still armed from a tap: already made
+		if (layers)
+			layer_state_set(active_layers | layers);
+		oneshot_mods |= mods;
+		oneshot_layers |= layers;
+		oneshot_held_mods |= mods;
+		oneshot_held_layers |= layers;
+		oneshot_used_mods &= ~mods;
+		oneshot_used_layers &= ~layers;
+	} else if (record->tap.count) { // queued timeout fired before the next key
+		oneshot_release(mods, layers);
+	} else {
+		bool used = (oneshot_used_mods & mods) || (oneshot_used_layers & layers);
+
+		oneshot_held_mods &= ~mods;
+		oneshot_held_layers &= ~layers;
+		oneshot_used_mods &= ~mods;
+		oneshot_used_layers &= ~layers;
+		if (used) {
+			oneshot_release(mods, layers);
+		} else {
+			// tapped: stay armed, but not forever
+			record->tap.count = 1;
+			if (!ko_enqueue_timed_event(keycode, record, KO_ONESHOT_TIMEOUT))
+				oneshot_release(mods, layers); // no room for the timeout
+		}
+	}
+}
+/// REGION END
+
+// OP_NONE: a keycode, optionally wrapped in modifiers
+static void send_keycode_with_mods(uint16_t keycode, struct key_record* record) {
+	uint8_t mods = KEY_GET_MOD(keycode);
+	if (mods && record->event.pressed) // Send before on press
+		ko_send_modifiers(mods, record);
+	ko_send_keycode(keycode, record);
+	if (mods && !record->event.pressed) // Send after on release
+		ko_send_modifiers(mods, record);
+}
+
+#ifdef KO_LEADER
+/// REGION: Leader Key
+#define LEADER_IDLE 0xff
+static uint8_t leader_node = LEADER_IDLE;
+static struct key_pos leader_key; // where the pending timeout was queued from
+// Keys whose press went to the leader; their release must not leak out either
+static uint8_t leader_swallowed[(KEYBOARD_COLS_MAX * KEYBOARD_ROWS + 7)/8];
+
+static void leader_end(bool fire) {
+	struct key_record tap = {};
+	uint16_t action = leader_trie[leader_node].action;
+
+	leader_node = LEADER_IDLE;
+	tap.event.key = leader_key;
+	ko_cancel_tap_hold_event(KC_LEAD, &tap);
+
+	if (!fire || !action)
+		return;
+
+	tap.tap.count = 1;
+	tap.event.pressed = 1;
+	process_record(action, &tap);
+	oneshot_consume(action);
+	tap.event.pressed = 0;
+	process_record(action, &tap);
+}
+
+static void process_leader(struct key_record* record) {
+	if (record->event.pressed) {
+		struct key_record timeout = *record;
+		if (leader_node != LEADER_IDLE)
+			leader_end(false);
+		leader_node = 0;
+		leader_key = record->event.key;
+		timeout.event.pressed = 0;
+		timeout.tap.count = 1;
+		if (!ko_enqueue_timed_event(KC_LEAD, &timeout, KO_LEADER_TIMEOUT))
+			leader_node = LEADER_IDLE; // it could never time out
+	} else if (record->tap.count && leader_node != LEADER_IDLE) { // timed out
+		leader_end(true);
+	}
+}
+
+// Returns true if the leader consumed this event
+static bool leader_process(uint16_t keycode, struct key_record* record) {
+	uint8_t key = record->event.key.row * KEYBOARD_COLS_MAX + record->event.key.col;
+	const struct ko_leader_node* node;
+
+	if (!record->event.pressed) {
+		if (leader_swallowed[key / 8] & (1U << (key % 8))) {
+			leader_swallowed[key / 8] &= ~(1U << (key % 8));
+			return true;
+		}
+		return false;
+	}
+
+	if (leader_node == LEADER_IDLE || is_modifier_key(keycode))
+		return false;
+
+	leader_swallowed[key / 8] |= 1U << (key % 8);
+	node = &leader_trie[leader_node];
+	for (int i = 0; i < node->child_count; ++i) {
+		uint8_t child = node->first_child + i;
+		if (leader_trie[child].keycode == KEY_GET_KC(keycode)) {
+			leader_node = child;
+			if (!leader_trie[child].child_count)
+				leader_end(true);
+			return true;
+		}
+	}
+	leader_end(false); // no sequence continues with this key
+	return true;
+}
+/// REGION END
+#endif
+
+#ifdef KO_KEY_OVERRIDES
+/// REGION: Key Overrides
+static struct key_pos key_override_key; // trigger of the active override
+static uint16_t key_override_replacement;
+static uint8_t key_override_lifted; // platform modifier mask
+static bool key_override_active = false; // the replacement is down
+// Triggers still held. An override ended early by another key leaves its
+// trigger down, and another override can start before it comes up, so the
+// releases that belong to overrides are kept per key.
+static uint8_t key_override_triggers[(KEYBOARD_COLS_MAX * KEYBOARD_ROWS + 7)/8];
+
+static void key_override_end(void) {
+	struct key_record release = {};
+	send_keycode_with_mods(key_override_replacement, &release);
+	ko_restore_modifiers(key_override_lifted);
+	key_override_active = false;
+}
+
+static bool process_key_override(uint16_t keycode, struct key_record* record) {
+	uint8_t key = record->event.key.row * KEYBOARD_COLS_MAX + record->event.key.col;
+	const struct ko_key_override* o;
+	uint8_t mods;
+
+	if (!record->event.pressed) {
+		// Triggers are plain keycodes. Timeouts fired from the queue carry the
+		// record of a key that may have become a trigger since.
+		if (keycode >= key_override_count || !(key_override_triggers[key / 8] & (1U << (key % 8))))
+			return false;
+		key_override_triggers[key / 8] &= ~(1U << (key % 8));
+		if (key_override_active && record->event.key.row == key_override_key.row &&
+		    record->event.key.col == key_override_key.col)
+			key_override_end();
+		return true;
+	}
+
+	if (key_override_active)
+		key_override_end(); // the new key gets the real modifiers
+
+	if (keycode >= key_override_count) // also rules out ops and ACT_MOD
+		return false;
+	o = &key_overrides[keycode];
+	mods = ko_get_modifiers();
+	mods = (mods | mods >> 4) & 0xf; // either side
+	if (!o->replacement || (mods & o->mods) != o->mods)
+		return false;
+
+	key_override_key = record->event.key;
+	key_override_replacement = o->replacement;
+	key_override_lifted = ko_lift_modifiers(o->suppressed | o->suppressed << 4);
+	key_override_active = true;
+	key_override_triggers[key / 8] |= 1U << (key % 8);
+	send_keycode_with_mods(o->replacement, record);
+	return true;
+}
+/// REGION END
+#endif
+
+#ifdef KO_STATE_SNAPSHOT
+/// REGION: State Snapshot
+// The EC keeps its RAM through chipset suspend, so resuming normally has
+// nothing to restore: keys pressed to wake the system have already been
+// handled. Only the layers the suspend hooks turned off (the keymap drops FN
+// lock for the caps LED) are flipped back, so that a key which inverted one
+// of them in the meantime keeps its effect. The BBRAM snapshot
+// is applied only when that RAM was lost, and holds latched state alone:
+// layers held by keys would come back stuck once those keys are up.
+#define KO_SNAPSHOT_VERSION 2
+
+static bool          snapshot_suspended = false; // cleared with the rest of RAM
+static layer_state_t snapshot_dropped   = 0;     // layers the suspend hooks turned off
+
+static uint8_t snapshot_checksum(const uint8_t* snapshot) {
+	uint8_t sum = 0;
+	for (int i = 1; i < KO_SNAPSHOT_SIZE; ++i)
+		sum ^= snapshot[i];
+	return (sum ^ (sum >> 4)) & 0xf;
+}
+
+// Called before the suspend hooks
+void ko_snapshot_save(uint8_t* snapshot) {
+	snapshot_dropped = active_layers;
+	snapshot[1] = toggled_layers;
+	snapshot[2] = oneshot_mods;
+	snapshot[3] = oneshot_layers;
+	snapshot[0] = (KO_SNAPSHOT_VERSION << 4) | snapshot_checksum(snapshot);
+}
+
+// Called after the suspend hooks
+void ko_snapshot_suspended(void) {
+	snapshot_dropped &= ~active_layers;
+	snapshot_suspended = true;
+}
+
+// Called before the resume hooks; false if RAM did not survive the suspend
+// and the snapshot has to be restored instead.
+bool ko_snapshot_resume(void) {
+	if (!snapshot_suspended)
+		return false;
+	snapshot_suspended = false;
+	if (snapshot_dropped)
+		layer_state_set(active_layers ^ snapshot_dropped);
+	return true;
+}
+
+// Merges the latched state into whatever keys have done since boot; layer
+// hooks run a single time with the final state instead of once per layer.
+// Restored one-shots wait for the next key: their timeouts went with the RAM.
+bool ko_snapshot_restore(const uint8_t* snapshot) {
+	struct key_record press = {};
+
+	if ((snapshot[0] >> 4) != KO_SNAPSHOT_VERSION || (snapshot[0] & 0xf) != snapshot_checksum(snapshot))
+		return false;
+
+	press.event.pressed = 1;
+	oneshot_send_mods(snapshot[2] & ~oneshot_mods, &press);
+	oneshot_mods |= snapshot[2];
+	oneshot_layers |= snapshot[3];
+	toggled_layers |= snapshot[1];
+	layer_state_set(active_layers | snapshot[1] | snapshot[3]);
+	return true;
+}
+/// REGION END
+#endif
+
 /// REGION: Record Processing
 __attribute__((weak)) bool process_record_proto(uint16_t keycode, keyrecord_t* record) { return true; }
 __attribute__((weak)) bool process_record_kb(uint16_t keycode, keyrecord_t* record) { return true; }
@@ -114,15 +500,16 @@ bool process_record(uint16_t keycode, struct key_record* record) {
 		return false;
 	}
 
+#ifdef KO_KEY_OVERRIDES
+	if (process_key_override(keycode, record)) {
+		return false;
+	}
+#endif
+
 	// ... then the internal handler.
 	switch (KEY_GET_OP(keycode)) {
 		case OP_NONE: {
-			uint8_t mods = KEY_GET_MOD(keycode);
-			if (mods && record->event.pressed) // Send before on press
-				ko_send_modifiers(mods, record);
-			ko_send_keycode(keycode, record);
-			if (mods && !record->event.pressed) // Send after on release
-				ko_send_modifiers(mods, record);
+			send_keycode_with_mods(keycode, record);
 			return false;
 		}
 		case OP_MOD_TAP: {
@@ -136,6 +523,8 @@ bool process_record(uint16_t keycode, struct key_record* record) {
 			if (record->tap.count == 0) { // if held
 				uint8_t layer = KEY_GET_LAYER(keycode);
 				layer_state_set(active_layers ^ ((-(record->event.pressed != 0) ^ active_layers) & (1<<layer)));
+				if (!record->event.pressed)
+					toggled_layers &= ~(1U << layer);
 			} else {
 				ko_send_keycode(keycode, record);
 			}
@@ -145,23 +534,91 @@ bool process_record(uint16_t keycode, struct key_record* record) {
 			uint8_t layer = KEY_GET_LAYER(keycode);
 			if (record->event.pressed) {
 				layer_invert(layer);
+				toggled_layers ^= 1U << layer;
 			} // toggle actions take effect on press, not release
 			return false;
 		}
+		case OP_ONESHOT_MOD:
+		case OP_ONESHOT_LAYER: {
+			process_oneshot(keycode, record);
+			return false;
+		}
+		case OP_SPECIAL: {
+#ifdef KO_LEADER
+			if (keycode == KC_LEAD)
+				process_leader(record);
+#endif
+			return false;
+		}
 	}
 	return false;
 }
 
+// Quick tap: re-pressing a tap-hold key soon after tapping it sends the tap
+// keycode right away and keeps it held, so it auto-repeats. This bypasses
+// the queue entirely.
+static struct key_pos last_tap_key;
+static uint32_t last_tap_time;
+static uint8_t quick_tap_state = 0;
+enum _quick_tap_state {
+	QUICK_TAP_ARMED = 0b01, // last_tap_key was tapped at last_tap_time
+	QUICK_TAP_HELD  = 0b10, // last_tap_key is down and was sent as a tap
+};
+
+static bool is_last_tap_key(struct key_record* record) {
+	return record->event.key.row == last_tap_key.row && record->event.key.col == last_tap_key.col;
+}
+
+// Tap-hold keys pressed while the queue was full. They can't wait for a
+// decision, so they go out as a tap right away and their release breaks it.
+static uint8_t tap_hold_unqueued[(KEYBOARD_COLS_MAX * KEYBOARD_ROWS + 7)/8];
+
 static void process_tap_hold_action(uint16_t keycode, struct key_record* record) {
 	if (record->event.pressed) {
-		ko_enqueue_tap_hold_event(keycode, record);
+		if ((quick_tap_state & QUICK_TAP_ARMED) && is_last_tap_key(record) &&
+		    record->event.time - last_tap_time < KO_QUICK_TAP_TERM * MSEC) {
+			quick_tap_state |= QUICK_TAP_HELD;
+			record->tap.count = 1;
+			process_record(keycode, record);
+			oneshot_consume(keycode);
+			return;
+		}
+		if (!ko_enqueue_tap_hold_event(keycode, record)) {
+			uint8_t key = record->event.key.row * KEYBOARD_COLS_MAX + record->event.key.col;
+			tap_hold_unqueued[key / 8] |= 1U << (key % 8);
+			record->tap.count = 1;
+			process_record(keycode, record);
+			oneshot_consume(keycode);
+		}
 	} else {
+		uint8_t key = record->event.key.row * KEYBOARD_COLS_MAX + record->event.key.col;
+		if (tap_hold_unqueued[key / 8] & (1U << (key % 8))) {
+			tap_hold_unqueued[key / 8] &= ~(1U << (key % 8));
+			record->tap.count = 1;
+			process_record(keycode, record);
+			return;
+		}
+		if ((quick_tap_state & QUICK_TAP_HELD) && is_last_tap_key(record)) {
+			quick_tap_state = QUICK_TAP_ARMED;
+			last_tap_time = record->event.time;
+			record->tap.count = 1;
+			process_record(keycode, record);
+			return;
+		}
 		// if it was queued, cancel it and process a tap fire release
 		if (ko_cancel_tap_hold_event(keycode, record)) {
 			// cancel it
 			record->event.pressed = 1;
 			record->tap.count = 1;
 			process_record(keycode, record);
+			oneshot_consume(keycode);
+			if (!(quick_tap_state & QUICK_TAP_HELD)) { // a held repeat keeps last_tap_key until its release
+				last_tap_key = record->event.key;
+				last_tap_time = record->event.time;
+				quick_tap_state = QUICK_TAP_ARMED;
+			}
+		} else if (is_last_tap_key(record)) {
+			quick_tap_state = 0; // held this time; don't repeat the old tap
 		}
 		// if we can't find it, it already fired. send a release for the modifier or layer
 		// tap will be set to 1 if we found a press-fire already scheduled and 0 if we did not
@@ -172,44 +629,216 @@ static void process_tap_hold_action(uint16_t keycode, struct key_record* record)
 
 static struct key_record record;
 
-typedef uint8_t ternary_t;
-enum _ternary_t {
-	T_NOT_INSTALLED = 0,
-	T_SEND_EVENT = 1,
-	T_DROP_EVENT = 2
-};
-ternary_t matrix_callback_overload(int8_t row, int8_t col, int8_t pressed, uint16_t* make_code) {
+// Resolves the keycode for a matrix transition and runs it through the engine.
+static void process_matrix_transition(struct key_record* record) {
+	uint8_t row = record->event.key.row;
+	uint8_t col = record->event.key.col;
 	uint16_t keycode;
 
-	if (!ko_is_enabled()) {
-		return T_NOT_INSTALLED;
-	}
-
-	memset(&record, 0, sizeof(record));
-	record.event.key.row = row;
-	record.event.key.col = col;
-	record.event.pressed = pressed != 0;
-
-	if (pressed) {
+	if (record->event.pressed) {
 		uint8_t layer;
-		keycode = get_keycode_at_pos(row, col, &layer);
+		keycode = get_keycode_at_pos(base_layers | active_layers, row, col, &layer);
 		set_pressed_layer(row, col, layer);
+#ifdef KO_HEATMAP
+		heatmap_count(ko_heatmap, KO_HEATMAP_KEYS, row * KEYBOARD_COLS_MAX + col);
+		heatmap_count(ko_heatmap + KO_HEATMAP_KEYS, NUM_LAYERS_MAX, layer);
+#endif
 	} else {
 		uint8_t layer = get_pressed_layer(row, col);
 		keycode = keymaps[layer][col][row];
 		set_pressed_layer(row, col, 0);
 	}
 
+#ifdef KO_LEADER
+	if (leader_process(keycode, record)) {
+		return;
+	}
+#endif
+
 	/* Early: if keycode is a mod tap, queue it for later */
 	if (IS_TAP_HOLD_ACTION(keycode)) {
-		process_tap_hold_action(keycode, &record);
-		return T_DROP_EVENT;
+		process_tap_hold_action(keycode, record);
+		return;
+	}
+
+	process_record(keycode, record);
+	if (record->event.pressed) {
+		oneshot_consume(keycode);
+	}
+}
+
+// Anything that timed out before until is resolved first, so tap/hold
+// decisions follow event time and not when the task ran. until is the event's
+// own time unless debounce still holds back a release from before it.
+static void process_matrix_event(struct key_record* record, uint32_t until) {
+	ko_process_queue(until);
+	process_matrix_transition(record);
+}
+
+#ifdef KO_EAGER_DEBOUNCE
+// Eager-on-press, deferred-on-release debounce.
+// A press is reported on its first edge, then the key is locked until it has
+// been quiet for KO_DEBOUNCE ms; chatter inside that window is swallowed.
+// A release is only reported once the key has stayed released for the window.
+// Only keys inside a window hold a slot, so this costs a bitmap and a few
+// timestamps rather than one timestamp per key.
+// The scanner only calls in with edges it has debounced itself, so
+// ko_platform.c zeroes its windows while the engine is enabled; this is then
+// the only debounce between the matrix and the host.
+#define KO_DEBOUNCE_SLOTS 8
+struct ko_debounce_slot {
+	uint32_t ts;  // time of the last edge seen on this key
+	uint8_t key;  // row * KEYBOARD_COLS_MAX + col
+	uint8_t raw;  // last state seen from the scanner
+};
+static uint8_t debounce_locked[(KEYBOARD_COLS_MAX * KEYBOARD_ROWS + 7)/8];
+static struct ko_debounce_slot debounce_slots[KO_DEBOUNCE_SLOTS];
+static uint8_t debounce_slots_used; // one bit per slot
+BUILD_ASSERT(KO_DEBOUNCE_SLOTS <= 8);
+
+// Returns true if the edge should be processed right away.
+// A window always starts from the reported "down" state: either we report the
+// press now, or we hold back a release. Settling only ever has to report a
+// release, and only if the key is still up.
+static bool debounce_event(uint8_t row, uint8_t col, bool pressed, uint32_t now) {
+	uint8_t key = row * KEYBOARD_COLS_MAX + col;
+	int i;
+
+	if (debounce_locked[key / 8] & (1U << (key % 8))) {
+		for (i = 0; i < KO_DEBOUNCE_SLOTS; ++i) {
+			if ((debounce_slots_used & (1U << i)) && debounce_slots[i].key == key) {
+				debounce_slots[i].ts = now;
+				debounce_slots[i].raw = pressed;
+				break;
+			}
+		}
+		return false; // chatter
 	}
 
-	if (!process_record(keycode, &record)) {
+	for (i = 0; i < KO_DEBOUNCE_SLOTS; ++i) {
+		if (!(debounce_slots_used & (1U << i)))
+			break;
+	}
+	if (i == KO_DEBOUNCE_SLOTS)
+		return true; // out of slots: let the edge through undebounced
+
+	debounce_slots[i].ts = now;
+	debounce_slots[i].key = key;
+	debounce_slots[i].raw = pressed;
+	debounce_slots_used |= 1U << i;
+	debounce_locked[key / 8] |= 1U << (key % 8);
+	ko_wake_task();
+	return pressed;
+}
+
+// Called under the engine lock from ko_task_step, and before every scanner
+// edge so that windows which closed before the edge are not left to a late
+// task. Returns microseconds until the next window closes, or -1 if no key is
+// locked. Unless until is NULL, *until is pulled back to the earliest release
+// still held back, as timeouts after it have to wait to see whether that
+// release happens.
+int ko_debounce_settle(uint32_t now, uint32_t* until) {
+	int wait = -1;
+
+	for (int i = 0; i < KO_DEBOUNCE_SLOTS; ++i) {
+		struct ko_debounce_slot* slot = &debounce_slots[i];
+		int remaining;
+
+		if (!(debounce_slots_used & (1U << i)))
+			continue;
+
+		remaining = (KO_DEBOUNCE * MSEC) - (int)(now - slot->ts);
+		if (remaining > 0) {
+			wait = (wait < 0) ? remaining : MIN(wait, remaining);
+			if (until && !slot->raw && (int32_t)(slot->ts - *until) < 0)
+				*until = slot->ts;
+			continue;
+		}
+
+		debounce_slots_used &= ~(1U << i);
+		debounce_locked[slot->key / 8] &= ~(1U << (slot->key % 8));
+		if (!slot->raw && ko_is_enabled()) {
+			struct key_record release = {};
+			release.event.key.row = slot->key / KEYBOARD_COLS_MAX;
+			release.event.key.col = slot->key % KEYBOARD_COLS_MAX;
+			release.event.pressed = 0;
+			release.event.time = slot->ts; // when the key actually went up
+			process_matrix_event(&release, release.event.time);
+		}
+	}
+	return wait;
+}
+#endif
+
+ternary_t matrix_callback_overload(int8_t row, int8_t col, int8_t pressed, uint16_t* make_code) {
+	uint32_t time = ko_time_us(); // the only clock read for this event
+	uint32_t until = time;
+
+	if (!ko_is_enabled()) {
+		return T_NOT_INSTALLED;
+	}
+
+	ko_engine_lock();
+#ifdef KO_EAGER_DEBOUNCE
+	ko_debounce_settle(time, &until);
+	if (!debounce_event(row, col, pressed != 0, time)) {
+		ko_engine_unlock();
 		return T_DROP_EVENT;
 	}
+#endif
+
+	memset(&record, 0, sizeof(record));
+	record.event.key.row = row;
+	record.event.key.col = col;
+	record.event.pressed = pressed != 0;
+	record.event.time = time;
+
+	process_matrix_event(&record, until);
+	ko_engine_unlock();
+	return T_DROP_EVENT;
+}
+
+// Every transition in the batch shares one timestamp, one enable check and
+// one queue flush; they are processed column by column, lowest row first.
+// Layers are still resolved per transition: any of them can change layer
+// state (layer keys, one-shot layers, process_record_user), and the mask is
+// two loads, so holding it across the batch would save nothing.
+ternary_t matrix_batch_callback_overload(const uint8_t* changed, const uint8_t* state) {
+	uint32_t time = ko_time_us();
+	uint32_t until = time;
+
+	if (!ko_is_enabled()) {
+		return T_NOT_INSTALLED;
+	}
 
+	ko_engine_lock();
+#ifdef KO_EAGER_DEBOUNCE
+	ko_debounce_settle(time, &until);
+#endif
+	ko_process_queue(until);
+	memset(&record, 0, sizeof(record));
+
+	for (uint8_t col = 0; col < KEYBOARD_COLS_MAX; ++col) {
+		if (!changed[col])
+			continue;
+		for (uint8_t row = 0; row < KEYBOARD_ROWS; ++row) {
+			bool pressed = (state[col] & (1U << row)) != 0;
+
+			if (!(changed[col] & (1U << row)))
+				continue;
+#ifdef KO_EAGER_DEBOUNCE
+			if (!debounce_event(row, col, pressed, time))
+				continue;
+#endif
+			record.event.key.row = row;
+			record.event.key.col = col;
+			record.event.pressed = pressed;
+			record.event.time = time;
+			record.tap.count = 0;
+			process_matrix_transition(&record);
+		}
+	}
+	ko_engine_unlock();
 	return T_DROP_EVENT;
 }
 /// REGION END
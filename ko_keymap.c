@@ -55,6 +55,8 @@ const uint16_t keymaps[][KEYBOARD_COLS_MAX][KEYBOARD_ROWS] = {
         ),
 };
 
+const uint8_t keymap_layer_count = sizeof(keymaps) / sizeof(keymaps[0]);
+
 enum backlight_brightness {
 	KEYBOARD_BL_BRIGHTNESS_OFF = 0,
 	KEYBOARD_BL_BRIGHTNESS_LOW = 20,
@@ -120,12 +122,15 @@ bool process_record_user(uint16_t keycode, keyrecord_t* record) {
 }
 
 void ko_suspend_user(void) {
+#ifndef KO_STATE_SNAPSHOT // the engine snapshot already covers it
 	// Preserve the state of the FN key layer
 	system_set_bbram(SYSTEM_BBRAM_IDX_KEYBOARD_OVERDRIVE_STATE, layer_state_is(_FN_ANY));
+#endif
 	layer_off(_FN_ANY);
 }
 
 void ko_resume_user(void) {
+#ifndef KO_STATE_SNAPSHOT
 	uint8_t current_kb = 0;
 
 	if (system_get_bbram(SYSTEM_BBRAM_IDX_KEYBOARD_OVERDRIVE_STATE, &current_kb) == EC_SUCCESS) {
@@ -133,4 +138,5 @@ void ko_resume_user(void) {
 			layer_on(_FN_ANY);
 		}
 	}
+#endif
 }
@@ -1,15 +1,31 @@
 #include "ko_platform.h"
 
-#include "queue.h"
 #include "task.h"
 #include "host_command.h"
 #include "keyboard_8042_sharedlib.h"
+#include "keyboard_scan.h"
 
 static int8_t global_enable_keyboard_overload = 0;
 bool ko_is_enabled() {
 	return global_enable_keyboard_overload;
 }
 
+void ko_wake_task(void) {
+	task_wake(TASK_ID_KEYOVER);
+}
+
+// Engine state (layers, one-shots, caches, debounce slots) has no locking of
+// its own; this keeps the scanner, the task and the hooks from interleaving.
+// The queue mutex below nests inside it.
+static struct mutex ko_engine_mutex;
+void ko_engine_lock(void) {
+	mutex_lock(&ko_engine_mutex);
+}
+
+void ko_engine_unlock(void) {
+	mutex_unlock(&ko_engine_mutex);
+}
+
 // much easier to have a lookup table (256 bytes) for all keycodes to scancodes.
 // Instead of storing the entire raw set2 scancode, which is somewhat expensive,
 // we're going to compress it. All of the scancodes we care about range from 0x00
@@ -54,7 +70,49 @@ static uint16_t mod_scancodes[] = {
 	[7 /*MOD_RGUI*/] = 0xE027,
 };
 
+#ifdef KO_KEY_OVERRIDES
+static uint8_t ko_mods_down;   // by mod_scancodes index
+static uint8_t ko_mods_lifted; // broken by ko_lift_modifiers; the keys are still held
+
+static int8_t ko_modifier_index(uint8_t kc) {
+	switch (kc) {
+		case KC_LCTL: return 0;
+		case KC_LALT: return 1;
+		case KC_LSFT: return 2;
+		case KC_LGUI: return 3;
+		case KC_RCTL: return 4;
+		case KC_RALT: return 5;
+		case KC_RSFT: return 6;
+		case KC_RGUI: return 7;
+	}
+	return -1;
+}
+#endif
+
+static void ko_send_modifier(uint8_t index, bool pressed) {
+#ifdef KO_KEY_OVERRIDES
+	uint8_t bit = 1U << index;
+	if (ko_mods_lifted & bit) {
+		ko_mods_lifted &= ~bit;
+		if (!pressed)
+			return; // already broken when it was lifted
+	}
+	if (pressed)
+		ko_mods_down |= bit;
+	else
+		ko_mods_down &= ~bit;
+#endif
+	simulate_keyboard(mod_scancodes[index], pressed);
+}
+
 void ko_send_keycode(uint16_t keycode, struct key_record* record) {
+#ifdef KO_KEY_OVERRIDES
+	int8_t mod = ko_modifier_index(KEY_GET_KC(keycode));
+	if (mod >= 0) { // modifier keys share the tracking with ko_send_modifiers
+		ko_send_modifier(mod, record->event.pressed);
+		return;
+	}
+#endif
 	uint16_t scancode = s_keyCodeToCompressedScanCodeMapping[KEY_GET_KC(keycode)];
 	scancode ^= (-((scancode & 0x80) != 0) & 0xE080); // simultaneously sets high 0xE000 and clears 0x80 iff scancode contains 0x80
 	if (scancode == 0xe003) scancode = 0x83; // special-case the only value that breaks our optimization
@@ -64,50 +122,131 @@ void ko_send_keycode(uint16_t keycode, struct key_record* record) {
 void ko_send_modifiers(uint8_t mods, struct key_record* record) {
 	uint8_t offset = (mods & 0b10000) ? 4 : 0; // having any right modifiers makes all modifiers right
 	for(int i = 0; i < 4; ++i) {
-		if (mods & (1<<i)) {
-			simulate_keyboard(mod_scancodes[offset+i], record->event.pressed);
-		}
+		if (mods & (1<<i))
+			ko_send_modifier(offset+i, record->event.pressed);
+	}
+}
+
+#ifdef KO_KEY_OVERRIDES
+uint8_t ko_get_modifiers(void) {
+	return ko_mods_down;
+}
+
+uint8_t ko_lift_modifiers(uint8_t mods) {
+	mods &= ko_mods_down;
+	for (int i = 0; i < 8; ++i) {
+		if (mods & (1<<i))
+			ko_send_modifier(i, false);
 	}
+	ko_mods_lifted |= mods;
+	return mods;
 }
 
+void ko_restore_modifiers(uint8_t mods) {
+	mods &= ko_mods_lifted; // released in the meantime: nothing to put back
+	ko_mods_lifted &= ~mods;
+	for (int i = 0; i < 8; ++i) {
+		if (mods & (1<<i))
+			ko_send_modifier(i, true);
+	}
+}
+#endif
+
 struct ko_queued_event {
-	timestamp_t ts;
-	bool cancelled;
+	uint32_t ts; // fire time, measured from the event time of the record
 	uint16_t keycode;
 	struct key_record record;
 };
 
+// Merge two waits where -1 means "no deadline"
+#define KO_EARLIEST(a, b) ((a) < 0 ? (b) : (b) < 0 ? (a) : MIN((a), (b)))
+
+// Timed events sit in slots rather than a FIFO: tap-hold, one-shot and leader
+// deadlines differ, so entries expire and get cancelled out of order, and a
+// slot has to come free as soon as its entry is done with.
 static struct mutex ko_queue_mutex;
-static struct queue ko_queue = QUEUE_NULL(16, struct ko_queued_event);
-
-void ko_enqueue_tap_hold_event(uint16_t keycode, struct key_record* record) {
-	// enqueue record for future processing;
-	struct ko_queued_event ev = {};
-	ev.ts.val = get_time().val + (KO_TAP_TERM * MSEC); // fire time
-	ev.cancelled = false; // live
-	ev.record = *record; // copy
-	ev.keycode = keycode;
-	queue_add_unit(&ko_queue, &ev);
+#define KO_QUEUE_SIZE 16
+static struct ko_queued_event ko_queue[KO_QUEUE_SIZE];
+static uint16_t ko_queue_used; // one bit per slot
+BUILD_ASSERT(KO_QUEUE_SIZE <= 16);
+
+bool ko_enqueue_tap_hold_event(uint16_t keycode, struct key_record* record) {
+	return ko_enqueue_timed_event(keycode, record, KO_TAP_TERM);
+}
+
+bool ko_enqueue_timed_event(uint16_t keycode, struct key_record* record, uint16_t delay_ms) {
+	int i;
+
+	mutex_lock(&ko_queue_mutex);
+	for (i = 0; i < KO_QUEUE_SIZE; ++i) {
+		if (!(ko_queue_used & (1U << i)))
+			break;
+	}
+	if (i == KO_QUEUE_SIZE) {
+		mutex_unlock(&ko_queue_mutex);
+		return false;
+	}
+	ko_queue[i].ts = record->event.time + (delay_ms * MSEC); // fire time
+	ko_queue[i].record = *record; // copy
+	ko_queue[i].keycode = keycode;
+	ko_queue_used |= 1U << i;
+	mutex_unlock(&ko_queue_mutex);
 	task_wake(TASK_ID_KEYOVER);
+	return true;
 }
 
 bool ko_cancel_tap_hold_event(uint16_t keycode, struct key_record* record) {
-	struct queue_iterator it;
-	struct ko_queued_event* found = NULL;
+	bool found = false;
 
 	mutex_lock(&ko_queue_mutex);
-	queue_begin(&ko_queue, &it);
-	while(it.ptr != NULL) {
-		struct ko_queued_event* ev = (struct ko_queued_event*)it.ptr;
-		if (ev->record.event.key.row == record->event.key.row && ev->record.event.key.col == record->event.key.col) {
-			ev->cancelled = true;
-			found = ev;
+	for (int i = 0; i < KO_QUEUE_SIZE; ++i) {
+		struct ko_queued_event* ev = &ko_queue[i];
+		if ((ko_queue_used & (1U << i)) && ev->record.event.key.row == record->event.key.row && ev->record.event.key.col == record->event.key.col) {
+			ko_queue_used &= ~(1U << i);
+			found = true;
 			break;
 		}
-		queue_next(&ko_queue, &it);
 	}
 	mutex_unlock(&ko_queue_mutex);
-	return found != NULL;
+	return found;
+}
+
+void ko_cancel_timed_events(uint8_t op) {
+	mutex_lock(&ko_queue_mutex);
+	for (int i = 0; i < KO_QUEUE_SIZE; ++i) {
+		if ((ko_queue_used & (1U << i)) && KEY_GET_OP(ko_queue[i].keycode) == op)
+			ko_queue_used &= ~(1U << i);
+	}
+	mutex_unlock(&ko_queue_mutex);
+}
+
+int ko_process_queue(uint32_t now) {
+	for (;;) {
+		struct ko_queued_event copy;
+		int earliest = -1;
+		int remaining = 0;
+
+		// Always fire the earliest deadline first; processing a record may
+		// enqueue or cancel entries, so look again after every one.
+		mutex_lock(&ko_queue_mutex);
+		for (int i = 0; i < KO_QUEUE_SIZE; ++i) {
+			int r = (int32_t)(ko_queue[i].ts - now);
+			if ((ko_queue_used & (1U << i)) && (earliest < 0 || r < remaining)) {
+				earliest = i;
+				remaining = r;
+			}
+		}
+		if (earliest < 0 || remaining > 0) {
+			mutex_unlock(&ko_queue_mutex);
+			// Nothing is due yet: wait for the earliest pending entry
+			return earliest < 0 ? -1 : CLAMP(remaining, 1, KO_TAP_TERM * MSEC);
+		}
+		copy = ko_queue[earliest];
+		ko_queue_used &= ~(1U << earliest); // fired; the slot is free again
+		mutex_unlock(&ko_queue_mutex);
+		// we don't want to call under lock
+		process_record(copy.keycode, &copy.record);
+	}
 }
 
 /// ChromeOS EC PS/2 platform hooks
@@ -133,70 +272,141 @@ bool process_record_proto(uint16_t keycode, keyrecord_t* record) {
 struct ec_params_set_keyboard_overdrive {
 	uint8_t on;
 } __ec_align1;
+
+#ifdef KO_EAGER_DEBOUNCE
+// The scanner debounces before it calls matrix_callback_overload, which would
+// leave KO_DEBOUNCE nothing to do but delay releases. While the engine is on,
+// the scanner's windows are zeroed so every raw edge reaches debounce_event;
+// the board's values come back when it is turned off and the scanner reports
+// keys itself again.
+static uint16_t ko_board_debounce_down_us, ko_board_debounce_up_us;
+static bool ko_scan_debounce_off;
+
+static void ko_scan_debounce(bool on) {
+	if (on == !ko_scan_debounce_off)
+		return;
+	if (on) {
+		keyscan_config.debounce_down_us = ko_board_debounce_down_us;
+		keyscan_config.debounce_up_us = ko_board_debounce_up_us;
+	} else {
+		ko_board_debounce_down_us = keyscan_config.debounce_down_us;
+		ko_board_debounce_up_us = keyscan_config.debounce_up_us;
+		keyscan_config.debounce_down_us = 0;
+		keyscan_config.debounce_up_us = 0;
+	}
+	ko_scan_debounce_off = !on;
+}
+#endif
 static enum ec_status keyboard_overdrive(struct host_cmd_handler_args *args)
 {
 	const struct ec_params_set_keyboard_overdrive *p = args->params;
 	global_enable_keyboard_overload = p->on != 0;
+#ifdef KO_EAGER_DEBOUNCE
+	ko_scan_debounce(!global_enable_keyboard_overload);
+#endif
 	args->response_size = 0;
 	return EC_RES_SUCCESS;
 }
 DECLARE_HOST_COMMAND(EC_CMD_SET_KEYBOARD_OVERDRIVE, keyboard_overdrive, EC_VER_MASK(0));
 
+#ifdef KO_HEATMAP
+#define EC_CMD_KEYBOARD_OVERDRIVE_HEATMAP 0x3E7E
+
+struct ec_params_keyboard_overdrive_heatmap {
+	uint8_t offset; // first counter to return
+	uint8_t clear;  // reset the counters returned
+} __ec_align1;
+// Response: as many uint16_t counters from offset as fit; the host keeps
+// reading at offset + count until it has all KO_HEATMAP_COUNTERS.
+static enum ec_status keyboard_overdrive_heatmap(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_keyboard_overdrive_heatmap *p = args->params;
+	int count;
+
+	if (p->offset >= KO_HEATMAP_COUNTERS)
+		return EC_RES_INVALID_PARAM;
+
+	count = MIN(KO_HEATMAP_COUNTERS - p->offset, args->response_max / (int)sizeof(uint16_t));
+	memcpy(args->response, &ko_heatmap[p->offset], count * sizeof(uint16_t));
+	if (p->clear)
+		memset(&ko_heatmap[p->offset], 0, count * sizeof(uint16_t));
+	args->response_size = count * sizeof(uint16_t);
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_KEYBOARD_OVERDRIVE_HEATMAP, keyboard_overdrive_heatmap, EC_VER_MASK(0));
+#endif
+
+#ifdef KO_STATE_SNAPSHOT
+// The board lists the BBRAM bytes the snapshot may use, e.g.
+// #define KO_STATE_SNAPSHOT_BBRAM { SYSTEM_BBRAM_IDX_KEYBOARD_OVERDRIVE_STATE, ... }
+static const enum system_bbram_idx ko_snapshot_bbram[] = KO_STATE_SNAPSHOT_BBRAM;
+BUILD_ASSERT(ARRAY_SIZE(ko_snapshot_bbram) == KO_SNAPSHOT_SIZE);
+
+static void ko_snapshot_write(void) {
+	uint8_t snapshot[KO_SNAPSHOT_SIZE];
+
+	ko_snapshot_save(snapshot);
+	for (int i = 0; i < KO_SNAPSHOT_SIZE; ++i)
+		system_set_bbram(ko_snapshot_bbram[i], snapshot[i]);
+}
+
+static void ko_snapshot_read(void) {
+	uint8_t snapshot[KO_SNAPSHOT_SIZE];
+
+	for (int i = 0; i < KO_SNAPSHOT_SIZE; ++i) {
+		if (system_get_bbram(ko_snapshot_bbram[i], &snapshot[i]) != EC_SUCCESS)
+			return;
+	}
+	ko_snapshot_restore(snapshot);
+}
+#endif
+
 static void keyboard_overdrive_suspend(void) {
+	ko_engine_lock();
+#ifdef KO_STATE_SNAPSHOT
+	ko_snapshot_write(); // before the hooks get a chance to turn layers off
+#endif
 	ko_suspend_kb();
 	ko_suspend_user();
+#ifdef KO_STATE_SNAPSHOT
+	ko_snapshot_suspended();
+#endif
+	ko_engine_unlock();
 	//dustin consider pretending that we have an eeprom api
 }
 DECLARE_HOOK(HOOK_CHIPSET_SUSPEND, keyboard_overdrive_suspend, HOOK_PRIO_DEFAULT);
 
 static void keyboard_overdrive_resume(void) {
+	ko_engine_lock();
+#ifdef KO_STATE_SNAPSHOT
+	if (!ko_snapshot_resume())
+		ko_snapshot_read();
+#endif
 	ko_resume_kb();
 	ko_resume_user();
+	ko_engine_unlock();
 }
 DECLARE_HOOK(HOOK_CHIPSET_RESUME, keyboard_overdrive_resume, HOOK_PRIO_DEFAULT);
 
+int ko_task_step(void) {
+	uint32_t until;
+	int wait = -1;
+
+	ko_engine_lock();
+	until = ko_time_us();
+#ifdef KO_EAGER_DEBOUNCE
+	wait = ko_debounce_settle(until, &until);
+#endif
+	wait = KO_EARLIEST(wait, ko_process_queue(until));
+	ko_engine_unlock();
+	return wait;
+}
+
 void keyboard_overdrive_task(void* u) {
 	int wait = -1;
 	while(1) {
-		struct queue_iterator it;
-		timestamp_t t;
-		int i = 0;
-
 		task_wait_event(wait); // well, have a nap...
-
-		if (queue_is_empty(&ko_queue)) {
-			// if queue is empty, break and go back to sleep
-			wait = -1;
-			continue;
-		}
-
-		mutex_lock(&ko_queue_mutex);
-		t = get_time();
-		queue_begin(&ko_queue, &it);
-		while(it.ptr) { // we will always bail early or run out of queue
-			struct ko_queued_event* e = (struct ko_queued_event*)it.ptr;
-			// look at e: if it has been cancelled, we can remove it later
-			if (e->cancelled) {
-				++i; // remove this entry
-			} else if (timestamp_expired(e->ts, &t)) {
-				struct ko_queued_event copy = *e;
-				++i; // remove this entry
-				mutex_unlock(&ko_queue_mutex);
-				// we don't want to call under lock
-				// RISK (TODO): processing a record could modify the queue...
-				process_record(copy.keycode, &copy.record);
-				mutex_lock(&ko_queue_mutex);
-			} else {
-				int remaining = e->ts.val - t.val;
-				// The first event is not ready yet,
-				// so we should wait for it to be ready.
-				wait = CLAMP(remaining, 1, KO_TAP_TERM * MSEC);
-				break;
-			}
-			queue_next(&ko_queue, &it);
-		}
-		queue_advance_head(&ko_queue, i); // delete the cancelled and processed events
-		mutex_unlock(&ko_queue_mutex);
+		wait = ko_task_step();
 	}
 }
 /// REGION END
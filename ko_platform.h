@@ -6,6 +6,7 @@
 #include "common.h"
 #include "stdbool.h"
 #include "system.h"
+#include "timer.h"
 #include "util.h"
 #include "keyboard_overdrive.h"
 
@@ -14,10 +15,74 @@
 #define CPRINTF(format, args...) cprintf(CC_KEYBOARD, format, ## args)
 
 #define ko_topmost_active_layer(layers) __fls((layers))
+#define ko_time_us() (get_time().le.lo)
 void ko_send_keycode(uint16_t keycode, struct key_record* record);
 void ko_send_modifiers(uint8_t modifiers, struct key_record* record);
-void ko_enqueue_tap_hold_event(uint16_t keycode, struct key_record* record);
+// Enqueueing returns false when every slot is taken
+bool ko_enqueue_tap_hold_event(uint16_t keycode, struct key_record* record);
+bool ko_enqueue_timed_event(uint16_t keycode, struct key_record* record, uint16_t delay_ms);
 bool ko_cancel_tap_hold_event(uint16_t keycode, struct key_record* record);
+void ko_cancel_timed_events(uint8_t op); // drops every queued event with this opcode
+// Fires queued events due at or before now (an event time); returns
+// microseconds until the next one is due, or -1 if none are pending
+int ko_process_queue(uint32_t now);
 bool ko_is_enabled(void);
+void ko_wake_task(void);
+// Held by every way into the engine (scanner callbacks, the task, the
+// suspend/resume hooks), which all run in different tasks
+void ko_engine_lock(void);
+void ko_engine_unlock(void);
+// One pass of keyboard_overdrive_task: settles debounce windows and fires
+// due timeouts; returns microseconds until it wants to run again, or -1
+int ko_task_step(void);
+#ifdef KO_EAGER_DEBOUNCE
+int ko_debounce_settle(uint32_t now, uint32_t* until);
+#endif
+
+// Scanner entry points, in keyboard_overdrive_lib.c. The EC's keyboard scanner
+// reports every key change it has debounced (every raw edge with
+// KO_EAGER_DEBOUNCE) through one of them. T_DROP_EVENT means the engine took
+// the change; T_NOT_INSTALLED means it is off and the scanner reports the key
+// itself.
+typedef uint8_t ternary_t;
+enum _ternary_t {
+	T_NOT_INSTALLED = 0,
+	T_SEND_EVENT = 1,
+	T_DROP_EVENT = 2
+};
+// One key: called from the scanner's per-key loop; make_code is unused.
+ternary_t matrix_callback_overload(int8_t row, int8_t col, int8_t pressed, uint16_t* make_code);
+// A whole scan: changed and state hold one byte of rows per column, like the
+// scanner's debounced_state. A scanner using it collects the changed bits in
+// check_keys_changed() and makes this one call before its per-key loop,
+// passing debounced_state; it skips that loop unless this returns
+// T_NOT_INSTALLED.
+ternary_t matrix_batch_callback_overload(const uint8_t* changed, const uint8_t* state);
+
+#ifdef KO_KEY_OVERRIDES
+// Modifier masks here have one bit per modifier scancode: left
+// ctrl/alt/shift/gui in the low nibble, right in the high nibble.
+uint8_t ko_get_modifiers(void); // modifiers made and not broken
+uint8_t ko_lift_modifiers(uint8_t mods); // breaks those that are made; returns them
+void ko_restore_modifiers(uint8_t mods); // makes lifted ones again unless released since
+#endif
+
+#ifdef KO_STATE_SNAPSHOT
+// Latched engine state kept in BBRAM across suspend, for when RAM is lost:
+// [0] version << 4 | checksum, [1] toggled layers, [2] one-shot mods, [3] one-shot layers
+#define KO_SNAPSHOT_SIZE 4
+void ko_snapshot_save(uint8_t* snapshot);
+void ko_snapshot_suspended(void);
+bool ko_snapshot_resume(void); // false if RAM was lost; restore the snapshot then
+bool ko_snapshot_restore(const uint8_t* snapshot);
+#endif
+
+#ifdef KO_HEATMAP
+// Press counters: one per matrix position (row * KEYBOARD_COLS_MAX + col),
+// followed by one per resolved layer.
+#define KO_HEATMAP_KEYS (KEYBOARD_COLS_MAX * KEYBOARD_ROWS)
+#define KO_HEATMAP_COUNTERS (KO_HEATMAP_KEYS + NUM_LAYERS_MAX)
+extern uint16_t ko_heatmap[KO_HEATMAP_COUNTERS];
+#endif
 
 #endif